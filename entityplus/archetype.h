@@ -0,0 +1,154 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <limits>
+
+namespace entityplus {
+namespace detail {
+constexpr auto no_archetype_edge = std::numeric_limits<std::size_t>::max();
+
+// Every entity in a table has exactly the components and tags of its signature. Columns of
+// components outside the signature stay empty.
+template <typename Bitset, std::size_t BitCount, typename... Components>
+struct archetype_table {
+	Bitset signature;
+	std::vector<entity_id_t> ids;
+	std::tuple<std::vector<Components>...> columns;
+	// Table reached by flipping each bit, filled in on first use
+	std::array<std::size_t, BitCount> edges;
+
+	explicit archetype_table(const Bitset &signature) : signature(signature) {
+		edges.fill(no_archetype_edge);
+	}
+};
+
+struct archetype_location {
+	std::size_t table, row;
+};
+} // namespace detail
+
+// Same interface as the default entity_manager, minus groupings, events and the other
+// per-component extras. Iteration never searches, but adding or removing a component or tag
+// moves the entity's components to another table.
+template <typename... Components, typename... Tags>
+class entity_manager<component_list<Components...>, tag_list<Tags...>, singleton_list<>, archetype_storage> {
+public:
+	using component_list_t = component_list<Components...>;
+	using tag_list_t = tag_list<Tags...>;
+	using entity_t = detail::entity<component_list_t, tag_list_t, archetype_storage>;
+private:
+	using component_t = meta::typelist<Components...>;
+	using tag_t = meta::typelist<Tags...>;
+	using comp_tag_t = meta::typelist<Components..., Tags...>;
+	using bitset_t = meta::type_bitset<comp_tag_t>;
+
+	friend entity_t;
+
+	static_assert(meta::is_typelist_unique_v<comp_tag_t>,
+				  "component_list and tag_list must not intersect");
+	static_assert(meta::and_all<meta::not_<soa_traits<Components>>...>::value,
+				  "archetype_storage doesn't support soa_layout components");
+	static_assert(meta::and_all<meta::not_<detail::shared_traits<Components>>...>::value,
+				  "archetype_storage doesn't support shared components");
+
+	constexpr static auto ComponentCount = sizeof...(Components);
+	constexpr static auto TagCount = sizeof...(Tags);
+	constexpr static auto CompTagCount = ComponentCount + TagCount;
+
+	using table_t = detail::archetype_table<bitset_t, CompTagCount, Components...>;
+	using location_t = detail::archetype_location;
+
+	detail::entity_id_t currentEntityId = 0;
+	// tables[0] is the empty signature, tables are never removed so indices stay valid
+	std::vector<table_t> tables{table_t{bitset_t{}}};
+	flat_map<detail::entity_id_t, location_t> locations;
+
+	[[noreturn]] void report_error(error_code_t errCode, const char * error) const;
+
+	std::pair<const location_t*, entity_status> get_entity_and_status(const entity_t &entity) const;
+#if !NDEBUG
+	const location_t & assert_entity(const entity_t &entity) const;
+#endif
+
+	std::size_t find_table(const bitset_t &signature);
+	std::size_t get_edge(std::size_t table, std::size_t bit);
+
+	// Moves the entity at row of from into to, the caller constructs any new components first
+	void migrate(location_t &loc, std::size_t to);
+	void remove_row(table_t &table, std::size_t row);
+
+	template <typename Component>
+	std::vector<Component> & get_column(std::size_t table) {
+		return std::get<std::vector<Component>>(tables[table].columns);
+	}
+
+	template <typename Component, typename... Args>
+	std::pair<detail::component_reference_t<Component>, bool> add_component(entity_t &entity, std::tuple<Args...> &&args);
+
+	template <typename Component>
+	bool remove_component(entity_t &entity);
+
+	template <typename Component>
+	detail::component_const_reference_t<Component> get_component(const entity_t &entity) const;
+
+	template <typename Component>
+	detail::component_reference_t<Component> get_component(const entity_t &entity) {
+		return const_cast<Component &>(meta::as_const(*this).template get_component<Component>(entity));
+	}
+
+	template <typename Tag>
+	bool set_tag(entity_t &entity, bool set);
+
+	bool sync(entity_t &entity) const;
+
+	void destroy_entity(const entity_t &entity);
+
+	template <typename... Ts, typename Func, typename Cond>
+	void for_each_impl(Func &&func, Cond withControl);
+public:
+	using return_container = std::vector<entity_t>;
+
+	entity_manager() = default;
+	entity_manager(const entity_manager &) = delete;
+	entity_manager& operator=(const entity_manager &) = delete;
+
+	template <typename... Ts, typename... Us>
+	entity_t create_entity(Us&&... us);
+
+	// Gets all entities that have the components and tags provided, in id order
+	template <typename... Ts>
+	return_container get_entities();
+
+	// Visits the matching entities table by table, rather than in id order
+	template <typename... Ts, typename Func>
+	void for_each(Func && func);
+
+	std::size_t get_table_count() const {
+		return tables.size();
+	}
+
+#ifdef ENTITYPLUS_NO_EXCEPTIONS
+	using error_callback_t = void(error_code_t, const char *);
+private:
+	std::function<error_callback_t> errorCallback;
+
+	[[noreturn]] void handle_error(error_code_t err, const char *msg) const {
+		if (errorCallback) errorCallback(err, msg);
+		std::terminate();
+	}
+public:
+	void set_error_callback(std::function<error_callback_t> cb) {
+		errorCallback = std::move(cb);
+	}
+#endif
+};
+}
+
+#include "archetype.impl"
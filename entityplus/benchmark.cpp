@@ -3,8 +3,10 @@ static_assert(false, "Running in debug move");
 #endif
 
 #include <entityplus/entity.h>
+#include <entityplus/event.h>
 #include <entityx/entityx.h>
 #include <chrono>
+#include <sstream>
 #include <iostream>
 
 class Timer {
@@ -19,25 +21,25 @@ public:
 	}
 };
 
+template <typename Storage>
 void entPlusTest(int entityCount, int iterationCount, int tagProb) {
 	using namespace entityplus;
-	entity_manager<component_list<int>, tag_list<struct Tag>> em;
-	em.create_grouping<int, Tag>();
-	std::cout << "EntityPlus\n";
+	entity_manager<component_list<int>, tag_list<struct Tag>, singleton_list<>, Storage> em;
+	std::cout << (std::is_same<Storage, archetype_storage>::value ? "EntityPlus archetypes\n" : "EntityPlus\n");
 	{
 		Timer timer("Add entities: ");
 		for (int i = 0; i < entityCount; ++i) {
 			auto ent = em.create_entity();
-			ent.add_component<int>(i);
+			ent.template add_component<int>(i);
 			if (i % tagProb == 0)
-				ent.set_tag<Tag>(true);
+				ent.template set_tag<Tag>(true);
 		}
 	}
 	{
 		Timer timer("For_each entities: ");
 		std::uint64_t sum = 0;
 		for (int i = 0; i < iterationCount; ++i) {
-			em.for_each<Tag, int>([&](auto ent, auto i) {
+			em.template for_each<Tag, int>([&](auto ent, auto i) {
 				sum += i;
 			});
 		}
@@ -45,6 +47,107 @@ void entPlusTest(int entityCount, int iterationCount, int tagProb) {
 	}
 }
 
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+struct Health { int hp; };
+struct Armor { int value; };
+
+// Several components per entity, where the per-component maps have to search for each one
+template <typename Storage>
+void entPlusWideTest(int entityCount, int iterationCount) {
+	using namespace entityplus;
+	entity_manager<component_list<Position, Velocity, Health, Armor>, tag_list<>, singleton_list<>, Storage> em;
+	std::cout << (std::is_same<Storage, archetype_storage>::value ? "EntityPlus archetypes\n" : "EntityPlus\n");
+	{
+		Timer timer("Add entities: ");
+		for (int i = 0; i < entityCount; ++i) {
+			auto ent = em.create_entity(Position{float(i), 0}, Velocity{1, 1});
+			if (i % 2 == 0) ent.template add_component<Health>(Health{i});
+			if (i % 3 == 0) ent.template add_component<Armor>(Armor{i});
+		}
+	}
+	{
+		Timer timer("For_each entities: ");
+		float sum = 0;
+		for (int i = 0; i < iterationCount; ++i) {
+			em.template for_each<Position, Velocity, Health>([&](auto, auto &pos, auto &vel, auto &health) {
+				pos.x += vel.x;
+				sum += pos.x + float(health.hp);
+			});
+		}
+		std::cout << sum << "\n";
+	}
+}
+
+// Flips tags on every entity each frame, then visits the entities with both
+void entPlusTagToggleTest(int entityCount, int frameCount) {
+	using namespace entityplus;
+	entity_manager<component_list<Position>, tag_list<struct Visible, struct Active>> em;
+	std::vector<decltype(em)::entity_t> ents;
+	for (int i = 0; i < entityCount; ++i) {
+		ents.push_back(em.create_entity(Position{float(i), 0}));
+	}
+	Timer timer("Toggle and for_each tags: ");
+	float sum = 0;
+	for (int frame = 0; frame < frameCount; ++frame) {
+		for (int i = 0; i < entityCount; ++i) {
+			ents[i].set_tag<Visible>((i + frame) % 3 == 0);
+			ents[i].set_tag<Active>((i + frame) % 2 == 0);
+		}
+		em.for_each<Visible, Active>([&](auto ent) {
+			sum += ent.template get_component<Position>().x;
+		});
+	}
+	std::cout << sum << "\n";
+}
+
+// Cost of dispatch alone, the subscribers barely do anything
+void entPlusBroadcastTest(int subscriberCount, int broadcastCount) {
+	using namespace entityplus;
+	event_manager<component_list<>, tag_list<>, int> em;
+	std::vector<subscriber_handle<int>> subs;
+	std::uint64_t sum = 0;
+	for (int i = 0; i < subscriberCount; ++i) {
+		subs.push_back(em.subscribe<int>([&sum, i](int x) { sum += x + i; }));
+	}
+	Timer timer("Broadcast: ");
+	for (int i = 0; i < broadcastCount; ++i) em.broadcast(i);
+	std::cout << sum << "\n";
+}
+
+// Throughput of recording events and of replaying them
+void entPlusJournalTest(int eventCount, int frameSize) {
+	using namespace entityplus;
+	struct hit {
+		int target, damage;
+	};
+	using manager_t = event_manager<component_list<>, tag_list<>, hit>;
+	manager_t recorded, replayed;
+	event_journal<component_list<>, tag_list<>, hit> journal;
+	std::uint64_t sum = 0;
+	replayed.subscribe<hit>([&sum](const hit &event) { sum += event.damage; });
+	journal.attach(recorded);
+	{
+		Timer timer("Record: ");
+		for (int i = 0; i < eventCount; ++i) {
+			if (i % frameSize == 0) journal.begin_frame();
+			recorded.broadcast(hit{i, i % 7});
+		}
+	}
+	journal.detach();
+	std::stringstream stream;
+	{
+		Timer timer("Save and load: ");
+		journal.save(stream);
+		journal.load(stream);
+	}
+	{
+		Timer timer("Replay: ");
+		journal.replay(replayed);
+	}
+	std::cout << sum << " " << journal.size_bytes() << "\n";
+}
+
 void entXTest(int entityCount, int iterationCount, int tagProb) {
 	using namespace entityx;
 	struct Tag {};
@@ -75,7 +178,8 @@ void runTest(int entityCount, int iterationCount, int tagProb) {
 	std::cout << "Count: " << entityCount
 		<< " ItrCount: " << iterationCount
 		<< " TagProb: " << tagProb << "\n";
-	entPlusTest(entityCount, iterationCount, tagProb);
+	entPlusTest<entityplus::per_component_storage>(entityCount, iterationCount, tagProb);
+	entPlusTest<entityplus::archetype_storage>(entityCount, iterationCount, tagProb);
 	//std::cout << "\n";
 	//entXTest(entityCount, iterationCount, tagProb);
 	std::cout << "\n\n";
@@ -88,4 +192,26 @@ int main() {
 	runTest(100'000, 100'000, 5);
 	runTest(10'000, 1'000'000, 1'000);
 	runTest(100'000, 1'000'000, 1'000);
+
+	for (auto count : {10'000, 100'000}) {
+		std::cout << "Wide Count: " << count << "\n";
+		entPlusWideTest<entityplus::per_component_storage>(count, 1'000);
+		entPlusWideTest<entityplus::archetype_storage>(count, 1'000);
+		std::cout << "\n\n";
+	}
+
+	for (auto count : {10'000, 50'000}) {
+		std::cout << "Tag toggle Count: " << count << "\n";
+		entPlusTagToggleTest(count, 100);
+		std::cout << "\n\n";
+	}
+
+	for (auto count : {1, 10, 100}) {
+		std::cout << "Subscriber Count: " << count << "\n";
+		entPlusBroadcastTest(count, 10'000'000 / count);
+		std::cout << "\n\n";
+	}
+
+	std::cout << "Journal\n";
+	entPlusJournalTest(10'000'000, 1'000);
 }
@@ -7,10 +7,51 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
+#include <cassert>
+#include <numeric>
 #include <algorithm>
+#include <type_traits>
+
+#include "metafunctions.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace entityplus {
 
+// Memory held by a container. bytes is everything allocated, slack is the part of it that
+// doesn't hold any value, like the capacity past size() of a vector.
+struct container_stats {
+	std::size_t size = 0, capacity = 0, bytes = 0, slack = 0;
+
+	// Counts the memory of a container backing this one, such as an index
+	void add_memory(const container_stats &other) {
+		bytes += other.bytes;
+		slack += other.slack;
+	}
+};
+
+namespace detail {
+template <typename T, typename Allocator>
+container_stats vector_stats(const std::vector<T, Allocator> &vec) {
+	container_stats stats;
+	stats.size = vec.size();
+	stats.capacity = vec.capacity();
+	stats.bytes = vec.capacity() * sizeof(T);
+	stats.slack = (vec.capacity() - vec.size()) * sizeof(T);
+	return stats;
+}
+
+// Makes room for extra more values, growing geometrically so repeated batches stay amortized
+template <typename Vector>
+void reserve_more(Vector &vec, std::size_t extra) {
+	auto needed = vec.size() + extra;
+	if (needed > vec.capacity()) vec.reserve(std::max(needed, vec.capacity() * 2));
+}
+} // namespace detail
+
 template <typename Key, typename Compare = std::less<Key>,
 	typename Allocator = std::allocator<Key>>
 class flat_set : private std::vector<Key, Allocator> {
@@ -48,6 +89,14 @@ public:
 	using container_type::empty;
 	using container_type::size;
 	using container_type::max_size;
+	using container_type::capacity;
+	using container_type::reserve;
+	using container_type::shrink_to_fit;
+	using container_type::clear;
+
+	container_stats memory_stats() const {
+		return detail::vector_stats(static_cast<const container_type &>(*this));
+	}
 
 	template <typename... Args>
 	std::pair<iterator, bool> emplace(Args&&... args) {
@@ -63,6 +112,14 @@ public:
 		return{std::rotate(rbegin(), rbegin() + 1, reverse_iterator{lower}).base(), true};
 	}
 
+	// Same as emplace for a key larger than every stored one, without searching
+	template <typename... Args>
+	iterator emplace_back(Args&&... args) {
+		container_type::emplace_back(std::forward<Args>(args)...);
+		assert(size() == 1 || comp(*(end() - 2), container_type::back()));
+		return end() - 1;
+	}
+
 	iterator find(const key_type &key) {
 		auto lower = std::lower_bound(begin(), end(), key, comp);
 		if (lower != end() && *lower == key) return lower;
@@ -83,10 +140,19 @@ public:
 		erase(itr);
 		return 1;
 	}
+
+	// Removes every value pred returns true for in one pass
+	template <typename Pred>
+	size_type erase_if(Pred pred) {
+		auto first = std::remove_if(begin(), end(), pred);
+		auto removed = static_cast<size_type>(end() - first);
+		container_type::erase(first, end());
+		return removed;
+	}
 	
 	static flat_set from_sorted_underlying(container_type &&other) {
 		flat_set set;
-		static_cast<container_type &>(set) = other;
+		static_cast<container_type &>(set) = std::move(other);
 		return set;
 	}
 };
@@ -142,6 +208,14 @@ public:
 	using container_type::empty;
 	using container_type::size;
 	using container_type::max_size;
+	using container_type::capacity;
+	using container_type::reserve;
+	using container_type::shrink_to_fit;
+	using container_type::clear;
+
+	container_stats memory_stats() const {
+		return detail::vector_stats(static_cast<const container_type &>(*this));
+	}
 
 	template <typename... Args>
 	std::pair<iterator, bool> emplace(Args&&... args) {
@@ -158,6 +232,22 @@ public:
 
 	}
 
+	// Same as emplace for a key larger than every stored one, without searching
+	template <typename... Args>
+	iterator emplace_back(Args&&... args) {
+		container_type::emplace_back(std::forward<Args>(args)...);
+		assert(size() == 1 || valComp(*(end() - 2), container_type::back()));
+		return end() - 1;
+	}
+
+	// Same as emplacing value under each of keys, which must be sorted and larger than every
+	// stored key, but without searching
+	size_type insert_sorted_keys(const std::vector<key_type> &keys, const mapped_type &value) {
+		detail::reserve_more(*this, keys.size());
+		for (const auto &key : keys) emplace_back(key, value);
+		return keys.size();
+	}
+
 	iterator find(const key_type &key) {
 		auto lower = std::lower_bound(begin(), end(), key,
 									  [&](const value_type &val, const key_type &key) {
@@ -184,6 +274,701 @@ public:
 		erase(itr);
 		return 1;
 	}
+
+	// Removes every value pred returns true for in one pass
+	template <typename Pred>
+	size_type erase_if(Pred pred) {
+		auto first = std::remove_if(begin(), end(), pred);
+		auto removed = static_cast<size_type>(end() - first);
+		container_type::erase(first, end());
+		return removed;
+	}
+};
+
+
+namespace detail {
+// Drops the entries of the sorted keys from a key ordered index
+template <typename Index, typename Key>
+void erase_index_keys(Index &index, const std::vector<Key> &keys) {
+	index.erase_if([&](const typename Index::value_type &entry) {
+		return std::binary_search(keys.begin(), keys.end(), entry.first);
+	});
+}
+} // namespace detail
+
+// Values are stored contiguously in an arbitrary order that sort() can change,
+// lookups go through an index of keys kept in key order
+template <typename Key, typename T, typename Compare = std::less<Key>,
+	typename Allocator = std::allocator<std::pair<Key, T>>>
+class dense_map {
+public:
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = std::pair<Key, T>;
+	using container_type = std::vector<value_type, Allocator>;
+	using key_compare = Compare;
+	using size_type = typename container_type::size_type;
+	using difference_type = typename container_type::difference_type;
+	using reference = typename container_type::reference;
+	using const_reference = typename container_type::const_reference;
+	using iterator = typename container_type::iterator;
+	using const_iterator = typename container_type::const_iterator;
+	using index_type = flat_map<Key, size_type, Compare>;
+private:
+	container_type values;
+	index_type index;
+	bool customOrder = false;
+
+	// Reorders values so that the i-th value becomes the old perm[i]-th value
+	void apply_permutation(std::vector<size_type> &perm) {
+		std::vector<size_type> newPos(perm.size());
+		for (size_type i = 0; i < perm.size(); ++i) newPos[perm[i]] = i;
+		for (auto &entry : index) entry.second = newPos[entry.second];
+
+		for (size_type i = 0; i < perm.size(); ++i) {
+			auto curr = i;
+			while (perm[curr] != i) {
+				using std::swap;
+				swap(values[curr], values[perm[curr]]);
+				auto next = perm[curr];
+				perm[curr] = curr;
+				curr = next;
+			}
+			perm[curr] = curr;
+		}
+	}
+
+	template <typename Cmp>
+	auto value_comp(Cmp &cmp) {
+		return [&](size_type lhs, size_type rhs) {
+			return cmp(meta::as_const(values[lhs].second), meta::as_const(values[rhs].second));
+		};
+	}
+
+	// Moves the last value into idx, the index entry of the value that was there is left alone
+	void fill_hole(size_type idx) {
+		if (idx != values.size() - 1) {
+			values[idx] = std::move(values.back());
+			index.find(values[idx].first)->second = idx;
+		}
+		values.pop_back();
+	}
+public:
+	iterator begin() { return values.begin(); }
+	const_iterator begin() const { return values.begin(); }
+	const_iterator cbegin() const { return values.cbegin(); }
+	iterator end() { return values.end(); }
+	const_iterator end() const { return values.end(); }
+	const_iterator cend() const { return values.cend(); }
+
+	bool empty() const { return values.empty(); }
+	size_type size() const { return values.size(); }
+	size_type max_size() const { return values.max_size(); }
+	size_type capacity() const { return values.capacity(); }
+
+	void reserve(size_type count) {
+		values.reserve(count);
+		index.reserve(count);
+	}
+
+	void shrink_to_fit() {
+		values.shrink_to_fit();
+		index.shrink_to_fit();
+	}
+
+	// Keeps the memory for reuse
+	void clear() {
+		values.clear();
+		index.clear();
+		customOrder = false;
+	}
+
+	container_stats memory_stats() const {
+		auto stats = detail::vector_stats(values);
+		stats.add_memory(index.memory_stats());
+		return stats;
+	}
+
+	// Key ordered view of (key, position) pairs
+	const index_type & get_index() const {
+		return index;
+	}
+
+	// True once sort() has been called, iteration order is then meaningful
+	bool has_custom_order() const {
+		return customOrder;
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args&&... args) {
+		values.emplace_back(std::forward<Args>(args)...);
+		auto idx = index.emplace(values.back().first, values.size() - 1);
+		if (!idx.second) {
+			values.pop_back();
+			return{begin() + idx.first->second, false};
+		}
+		return{end() - 1, true};
+	}
+
+	iterator find(const key_type &key) {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+	const_iterator find(const key_type &key) const {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+
+	// Same as emplacing value under each of keys, which must be sorted and larger than every
+	// stored key, but without searching
+	size_type insert_sorted_keys(const std::vector<key_type> &keys, const mapped_type &value) {
+		detail::reserve_more(values, keys.size());
+		detail::reserve_more(index, keys.size());
+		for (const auto &key : keys) {
+			values.emplace_back(key, value);
+			index.emplace_back(key, values.size() - 1);
+		}
+		return keys.size();
+	}
+
+	// Fills the hole with the last value, so the order of the remaining values changes
+	iterator erase(const_iterator pos) {
+		auto idx = static_cast<size_type>(pos - cbegin());
+		index.erase(pos->first);
+		fill_hole(idx);
+		return begin() + idx;
+	}
+
+	// Same as erasing each of keys, which must be sorted, but the index is only compacted once.
+	// Keys that aren't in the map are skipped.
+	size_type erase_sorted_keys(const std::vector<key_type> &keys) {
+		size_type removed = 0;
+		for (const auto &key : keys) {
+			auto idx = index.find(key);
+			if (idx == index.end()) continue;
+			fill_hole(idx->second);
+			++removed;
+		}
+		if (removed) detail::erase_index_keys(index, keys);
+		return removed;
+	}
+	size_type erase(const key_type &key) {
+		auto itr = find(key);
+		if (itr == end()) return 0;
+		erase(itr);
+		return 1;
+	}
+
+	// cmp compares two mapped values
+	template <typename Cmp>
+	void sort(Cmp &&cmp) {
+		std::vector<size_type> perm(values.size());
+		std::iota(perm.begin(), perm.end(), size_type(0));
+		std::sort(perm.begin(), perm.end(), value_comp(cmp));
+		apply_permutation(perm);
+		customOrder = true;
+	}
+
+	// Cheaper than sort() when the values are already nearly sorted
+	template <typename Cmp>
+	void insertion_sort(Cmp &&cmp) {
+		std::vector<size_type> perm(values.size());
+		std::iota(perm.begin(), perm.end(), size_type(0));
+		auto comp = value_comp(cmp);
+		for (size_type i = 1; i < perm.size(); ++i) {
+			auto curr = perm[i];
+			auto j = i;
+			for (; j > 0 && comp(curr, perm[j - 1]); --j) perm[j] = perm[j - 1];
+			perm[j] = curr;
+		}
+		apply_permutation(perm);
+		customOrder = true;
+	}
+
+	// Puts the keys shared with other first, in the order of other
+	template <typename Other>
+	void arrange_like(const Other &other) {
+		std::vector<size_type> perm;
+		perm.reserve(values.size());
+		std::vector<bool> taken(values.size());
+		for (const auto &val : other) {
+			auto idx = index.find(val.first);
+			if (idx == index.end()) continue;
+			perm.push_back(idx->second);
+			taken[idx->second] = true;
+		}
+		for (size_type i = 0; i < values.size(); ++i) {
+			if (!taken[i]) perm.push_back(i);
+		}
+		apply_permutation(perm);
+		customOrder = true;
+	}
+};
+
+// Values are stored contiguously in an arbitrary order, keys index straight into an array of
+// positions. Lookups don't search, but the array grows to the largest key ever inserted.
+template <typename Key, typename T, typename Allocator = std::allocator<std::pair<Key, T>>>
+class sparse_map {
+	static_assert(std::is_unsigned<Key>::value, "sparse_map needs unsigned keys");
+public:
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = std::pair<Key, T>;
+	using container_type = std::vector<value_type, Allocator>;
+	using size_type = typename container_type::size_type;
+	using difference_type = typename container_type::difference_type;
+	using reference = typename container_type::reference;
+	using const_reference = typename container_type::const_reference;
+	using iterator = typename container_type::iterator;
+	using const_iterator = typename container_type::const_iterator;
+private:
+	container_type values;
+	// Position of each key plus one, 0 if the key isn't in the map
+	std::vector<size_type> positions;
+
+	size_type position_of(const key_type &key) const {
+		return key < positions.size() ? positions[key] : 0;
+	}
+public:
+	iterator begin() { return values.begin(); }
+	const_iterator begin() const { return values.begin(); }
+	const_iterator cbegin() const { return values.cbegin(); }
+	iterator end() { return values.end(); }
+	const_iterator end() const { return values.end(); }
+	const_iterator cend() const { return values.cend(); }
+
+	bool empty() const { return values.empty(); }
+	size_type size() const { return values.size(); }
+	size_type max_size() const { return values.max_size(); }
+	size_type capacity() const { return values.capacity(); }
+
+	// Only reserves values, positions depend on the keys that will be inserted
+	void reserve(size_type count) {
+		values.reserve(count);
+	}
+
+	// Also drops the positions past the largest key left
+	void shrink_to_fit() {
+		values.shrink_to_fit();
+		auto last = std::find_if(positions.rbegin(), positions.rend(), [](size_type pos) { return pos != 0; });
+		positions.erase(last.base(), positions.end());
+		positions.shrink_to_fit();
+	}
+
+	// Keeps the memory for reuse, only the positions in use are reset
+	void clear() {
+		for (const auto &val : values) positions[val.first] = 0;
+		values.clear();
+	}
+
+	// Every position that isn't holding a key counts as slack
+	container_stats memory_stats() const {
+		auto stats = detail::vector_stats(values);
+		stats.bytes += positions.capacity() * sizeof(size_type);
+		stats.slack += (positions.capacity() - values.size()) * sizeof(size_type);
+		return stats;
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args&&... args) {
+		values.emplace_back(std::forward<Args>(args)...);
+		auto key = values.back().first;
+		if (auto pos = position_of(key)) {
+			values.pop_back();
+			return{begin() + (pos - 1), false};
+		}
+		if (key >= positions.size()) positions.resize(key + 1);
+		positions[key] = values.size();
+		return{end() - 1, true};
+	}
+
+	// Same as emplacing value under each of keys, which must be sorted and not in the map yet
+	size_type insert_sorted_keys(const std::vector<key_type> &keys, const mapped_type &value) {
+		if (keys.empty()) return 0;
+		detail::reserve_more(values, keys.size());
+		if (keys.back() >= positions.size()) positions.resize(keys.back() + 1);
+		for (const auto &key : keys) {
+			assert(!position_of(key));
+			values.emplace_back(key, value);
+			positions[key] = values.size();
+		}
+		return keys.size();
+	}
+
+	iterator find(const key_type &key) {
+		auto pos = position_of(key);
+		return pos ? begin() + (pos - 1) : end();
+	}
+	const_iterator find(const key_type &key) const {
+		auto pos = position_of(key);
+		return pos ? begin() + (pos - 1) : end();
+	}
+
+	// Fills the hole with the last value, so the order of the remaining values changes
+	iterator erase(const_iterator pos) {
+		auto idx = static_cast<size_type>(pos - cbegin());
+		positions[pos->first] = 0;
+		if (idx != values.size() - 1) {
+			values[idx] = std::move(values.back());
+			positions[values[idx].first] = idx + 1;
+		}
+		values.pop_back();
+		return begin() + idx;
+	}
+	size_type erase(const key_type &key) {
+		auto itr = find(key);
+		if (itr == end()) return 0;
+		erase(itr);
+		return 1;
+	}
+};
+
+namespace detail {
+template <typename Value, typename Pages, std::size_t PageSize>
+class paged_iterator {
+	template <typename, typename, std::size_t>
+	friend class paged_iterator;
+
+	Pages *pages = nullptr;
+	std::size_t pos = 0;
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::remove_const_t<Value>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = Value *;
+	using reference = Value &;
+
+	paged_iterator() = default;
+	paged_iterator(Pages *pages, std::size_t pos) : pages(pages), pos(pos) {}
+	template <typename OtherValue, typename OtherPages,
+		typename = std::enable_if_t<std::is_convertible<OtherPages *, Pages *>::value>>
+	paged_iterator(const paged_iterator<OtherValue, OtherPages, PageSize> &other)
+		: pages(other.pages), pos(other.pos) {}
+
+	reference operator*() const {
+		return (*pages)[pos / PageSize][pos % PageSize];
+	}
+	pointer operator->() const {
+		return &**this;
+	}
+	reference operator[](difference_type n) const {
+		return *(*this + n);
+	}
+
+	paged_iterator & operator++() { ++pos; return *this; }
+	paged_iterator & operator--() { --pos; return *this; }
+	paged_iterator operator++(int) { auto ret = *this; ++pos; return ret; }
+	paged_iterator operator--(int) { auto ret = *this; --pos; return ret; }
+	paged_iterator & operator+=(difference_type n) { pos += n; return *this; }
+	paged_iterator & operator-=(difference_type n) { pos -= n; return *this; }
+	paged_iterator operator+(difference_type n) const { return{pages, pos + n}; }
+	paged_iterator operator-(difference_type n) const { return{pages, pos - n}; }
+	friend paged_iterator operator+(difference_type n, const paged_iterator &itr) { return itr + n; }
+
+	template <typename OtherValue, typename OtherPages>
+	difference_type operator-(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator==(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos == other.pos;
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator!=(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos != other.pos;
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator<(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos < other.pos;
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator>(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos > other.pos;
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator<=(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos <= other.pos;
+	}
+	template <typename OtherValue, typename OtherPages>
+	bool operator>=(const paged_iterator<OtherValue, OtherPages, PageSize> &other) const {
+		return pos >= other.pos;
+	}
+};
+} // namespace detail
+
+// Values are stored in pages of PageSize that are allocated once and never grow, so adding
+// values never moves the ones already there. Lookups go through an index of keys kept in key order.
+template <typename Key, typename T, std::size_t PageSize = 64, typename Compare = std::less<Key>>
+class paged_map {
+	static_assert(PageSize > 0, "paged_map needs a positive PageSize");
+public:
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = std::pair<Key, T>;
+	using key_compare = Compare;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using index_type = flat_map<Key, size_type, Compare>;
+private:
+	// Each page reserves PageSize values up front, so it's never reallocated
+	using page_type = std::vector<value_type>;
+	std::vector<page_type> pages;
+	size_type count = 0;
+	index_type index;
+
+	value_type & at(size_type pos) {
+		return pages[pos / PageSize][pos % PageSize];
+	}
+
+	// Moves the last value into idx, the index entry of the value that was there is left alone
+	void fill_hole(size_type idx) {
+		auto last = count - 1;
+		if (idx != last) {
+			at(idx) = std::move(at(last));
+			index.find(at(idx).first)->second = idx;
+		}
+		pages[last / PageSize].pop_back();
+		--count;
+		while (!pages.empty() && pages.back().empty()) pages.pop_back();
+	}
+public:
+	using iterator = detail::paged_iterator<value_type, std::vector<page_type>, PageSize>;
+	using const_iterator = detail::paged_iterator<const value_type, const std::vector<page_type>, PageSize>;
+
+	iterator begin() { return{&pages, 0}; }
+	const_iterator begin() const { return{&pages, 0}; }
+	const_iterator cbegin() const { return{&pages, 0}; }
+	iterator end() { return{&pages, count}; }
+	const_iterator end() const { return{&pages, count}; }
+	const_iterator cend() const { return{&pages, count}; }
+
+	bool empty() const { return count == 0; }
+	size_type size() const { return count; }
+	size_type max_size() const { return index.max_size(); }
+	size_type capacity() const { return pages.size() * PageSize; }
+
+	// Pages are still only allocated once they are needed
+	void reserve(size_type count) {
+		pages.reserve((count + PageSize - 1) / PageSize);
+		index.reserve(count);
+	}
+
+	// Drops the pages left empty by clear(), pages in use never have slack past the last one
+	void shrink_to_fit() {
+		pages.resize((count + PageSize - 1) / PageSize);
+		pages.shrink_to_fit();
+		index.shrink_to_fit();
+	}
+
+	// Keeps the pages for reuse
+	void clear() {
+		for (auto &page : pages) page.clear();
+		count = 0;
+		index.clear();
+	}
+
+	container_stats memory_stats() const {
+		container_stats stats;
+		stats.size = count;
+		stats.capacity = capacity();
+		stats.bytes = capacity() * sizeof(value_type);
+		stats.slack = (capacity() - count) * sizeof(value_type);
+		stats.add_memory(detail::vector_stats(pages));
+		stats.add_memory(index.memory_stats());
+		return stats;
+	}
+
+	// Key ordered view of (key, position) pairs
+	const index_type & get_index() const {
+		return index;
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args&&... args) {
+		if (count / PageSize == pages.size()) {
+			pages.emplace_back();
+			pages.back().reserve(PageSize);
+		}
+		auto &page = pages[count / PageSize];
+		page.emplace_back(std::forward<Args>(args)...);
+		auto idx = index.emplace(page.back().first, count);
+		if (!idx.second) {
+			page.pop_back();
+			return{begin() + idx.first->second, false};
+		}
+		++count;
+		return{end() - 1, true};
+	}
+
+	iterator find(const key_type &key) {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+	const_iterator find(const key_type &key) const {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+
+	// Same as emplacing value under each of keys, which must be sorted and larger than every
+	// stored key, but without searching
+	size_type insert_sorted_keys(const std::vector<key_type> &keys, const mapped_type &value) {
+		detail::reserve_more(index, keys.size());
+		for (const auto &key : keys) {
+			if (count / PageSize == pages.size()) {
+				pages.emplace_back();
+				pages.back().reserve(PageSize);
+			}
+			pages[count / PageSize].emplace_back(key, value);
+			index.emplace_back(key, count++);
+		}
+		return keys.size();
+	}
+
+	// Fills the hole with the last value, so the order of the remaining values changes
+	iterator erase(const_iterator pos) {
+		auto idx = static_cast<size_type>(pos - cbegin());
+		index.erase(pos->first);
+		fill_hole(idx);
+		return begin() + idx;
+	}
+
+	// Same as erasing each of keys, which must be sorted, but the index is only compacted once.
+	// Keys that aren't in the map are skipped.
+	size_type erase_sorted_keys(const std::vector<key_type> &keys) {
+		size_type removed = 0;
+		for (const auto &key : keys) {
+			auto idx = index.find(key);
+			if (idx == index.end()) continue;
+			fill_hole(idx->second);
+			++removed;
+		}
+		if (removed) detail::erase_index_keys(index, keys);
+		return removed;
+	}
+	size_type erase(const key_type &key) {
+		auto itr = find(key);
+		if (itr == end()) return 0;
+		erase(itr);
+		return 1;
+	}
+};
+
+namespace detail {
+constexpr std::size_t bit_vector_word_bits = 64;
+
+// Index of the lowest set bit, word must not be 0
+inline std::size_t lowest_bit(std::uint64_t word) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, word);
+	return idx;
+#else
+	return static_cast<std::size_t>(__builtin_ctzll(word));
+#endif
+}
+} // namespace detail
+
+// Growable array of bits, stored a 64 bit word at a time so several of them can be
+// combined without looking at the bits one by one. Bits past size() are always 0.
+class bit_vector {
+public:
+	using word_type = std::uint64_t;
+	using size_type = std::size_t;
+private:
+	std::vector<word_type> words;
+	size_type bitCount = 0, setCount = 0;
+
+	static word_type mask(size_type pos) {
+		return word_type(1) << (pos % detail::bit_vector_word_bits);
+	}
+public:
+	size_type size() const { return bitCount; }
+	bool empty() const { return bitCount == 0; }
+	// Number of set bits
+	size_type count() const { return setCount; }
+
+	size_type word_count() const { return words.size(); }
+	word_type word(size_type idx) const { return words[idx]; }
+	size_type capacity() const { return words.capacity() * detail::bit_vector_word_bits; }
+
+	void reserve(size_type bits) {
+		words.reserve((bits + detail::bit_vector_word_bits - 1) / detail::bit_vector_word_bits);
+	}
+
+	void shrink_to_fit() {
+		words.shrink_to_fit();
+	}
+
+	// Sizes are in bits, the unused bits of the last word aren't counted as slack
+	container_stats memory_stats() const {
+		auto stats = detail::vector_stats(words);
+		stats.size = bitCount;
+		stats.capacity = capacity();
+		return stats;
+	}
+
+	bool test(size_type pos) const {
+		assert(pos < bitCount);
+		return (words[pos / detail::bit_vector_word_bits] & mask(pos)) != 0;
+	}
+
+	void set(size_type pos, bool value) {
+		if (test(pos) == value) return;
+		words[pos / detail::bit_vector_word_bits] ^= mask(pos);
+		value ? ++setCount : --setCount;
+	}
+
+	void push_back(bool value) {
+		if (bitCount % detail::bit_vector_word_bits == 0) words.push_back(0);
+		++bitCount;
+		set(bitCount - 1, value);
+	}
+
+	// Shifts the bits after pos down by one
+	void erase(size_type pos) {
+		if (test(pos)) --setCount;
+		auto idx = pos / detail::bit_vector_word_bits;
+		auto low = mask(pos) - 1;
+		words[idx] = (words[idx] & low) | ((words[idx] >> 1) & ~low);
+		for (; idx + 1 < words.size(); ++idx) {
+			words[idx] |= words[idx + 1] << (detail::bit_vector_word_bits - 1);
+			words[idx + 1] >>= 1;
+		}
+		--bitCount;
+		if (bitCount % detail::bit_vector_word_bits == 0) words.pop_back();
+	}
+
+	// Same as erasing each of the sorted positions, but shifts the bits after them only once
+	void erase_sorted(const std::vector<size_type> &positions) {
+		if (positions.empty()) return;
+		auto removed = positions.begin();
+		auto dest = *removed;
+		for (auto pos = dest; pos < bitCount; ++pos) {
+			if (removed != positions.end() && *removed == pos) {
+				if (test(pos)) --setCount;
+				++removed;
+				continue;
+			}
+			auto bit = test(pos);
+			words[dest / detail::bit_vector_word_bits] &= ~mask(dest);
+			if (bit) words[dest / detail::bit_vector_word_bits] |= mask(dest);
+			++dest;
+		}
+		for (auto pos = dest; pos < bitCount; ++pos) words[pos / detail::bit_vector_word_bits] &= ~mask(pos);
+		bitCount = dest;
+		words.resize((bitCount + detail::bit_vector_word_bits - 1) / detail::bit_vector_word_bits);
+	}
+
+	void clear() {
+		words.clear();
+		bitCount = setCount = 0;
+	}
 };
 
 }
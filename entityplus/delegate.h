@@ -0,0 +1,147 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "metafunctions.h"
+
+namespace entityplus {
+namespace detail {
+constexpr std::size_t delegate_buffer_size = 4 * sizeof(void *);
+
+template <typename Func, typename Sig, typename = void>
+struct is_delegate_callable : std::false_type {};
+
+template <typename Func, typename R, typename... Args>
+struct is_delegate_callable<Func, R(Args...), meta::void_t<decltype(std::declval<Func &>()(std::declval<Args>()...))>>
+	: meta::or_<std::is_void<R>, std::is_convertible<decltype(std::declval<Func &>()(std::declval<Args>()...)), R>> {};
+
+template <typename Sig, std::size_t BufferSize = delegate_buffer_size>
+class delegate;
+
+// Type erased callable kept in a fixed buffer inside the delegate, so it never allocates.
+// Calling it is a single indirect call, which gets handed either the buffer or the context
+// given along with a plain function.
+template <typename R, typename... Args, std::size_t BufferSize>
+class delegate<R(Args...), BufferSize> {
+	enum class operation { copy, move, destroy };
+	using invoke_t = R(*)(void *, Args...);
+	using manage_t = void(*)(operation, void *, void *);
+	using buffer_t = typename std::aligned_storage<BufferSize, alignof(void *)>::type;
+
+	buffer_t buffer;
+	invoke_t invoker = nullptr;
+	void *context = nullptr;
+	// Null for callables that are copied bytewise and need no destructor
+	manage_t manager = nullptr;
+
+	template <typename Func>
+	static R invoke(void *self, Args... args) {
+		return (*static_cast<Func *>(self))(std::forward<Args>(args)...);
+	}
+
+	template <typename Func>
+	static void manage(operation op, void *dst, void *src) {
+		switch (op) {
+		case operation::copy:
+			new (dst) Func(*static_cast<const Func *>(src));
+			break;
+		case operation::move:
+			new (dst) Func(std::move(*static_cast<Func *>(src)));
+			break;
+		case operation::destroy:
+			static_cast<Func *>(dst)->~Func();
+			break;
+		}
+	}
+
+	bool is_inline() const {
+		return context == &buffer;
+	}
+
+	void take(const delegate &other, operation op) {
+		invoker = other.invoker;
+		manager = other.manager;
+		if (!other.is_inline()) {
+			context = other.context;
+			return;
+		}
+		context = &buffer;
+		if (manager) manager(op, &buffer, const_cast<buffer_t *>(&other.buffer));
+		else std::memcpy(&buffer, &other.buffer, sizeof(buffer));
+	}
+
+	void reset() {
+		if (is_inline() && manager) manager(operation::destroy, &buffer, nullptr);
+		invoker = nullptr;
+		context = nullptr;
+		manager = nullptr;
+	}
+public:
+	delegate() = default;
+
+	template <typename Func, typename F = std::decay_t<Func>,
+		typename = std::enable_if_t<!std::is_same<F, delegate>::value && is_delegate_callable<F, R(Args...)>::value &&
+									std::is_copy_constructible<F>::value>>
+	delegate(Func &&func) {
+		static_assert(sizeof(F) <= BufferSize && alignof(F) <= alignof(buffer_t),
+					  "Callable doesn't fit in a delegate, capture a pointer to the larger state instead");
+		new (&buffer) F(std::forward<Func>(func));
+		invoker = &invoke<F>;
+		context = &buffer;
+		using IsBytewise = meta::and_<std::is_trivially_copyable<F>, std::is_trivially_destructible<F>>;
+		manager = IsBytewise::value ? nullptr : &manage<F>;
+	}
+
+	// Calls func(context, args...), nothing is stored besides the two pointers
+	delegate(R(*func)(void *, Args...), void *funcContext) noexcept
+		: invoker(func), context(funcContext) {}
+
+	delegate(const delegate &other) {
+		take(other, operation::copy);
+	}
+
+	delegate(delegate &&other) noexcept {
+		take(other, operation::move);
+	}
+
+	delegate& operator=(const delegate &other) {
+		if (this != &other) {
+			reset();
+			take(other, operation::copy);
+		}
+		return *this;
+	}
+
+	delegate& operator=(delegate &&other) noexcept {
+		if (this != &other) {
+			reset();
+			take(other, operation::move);
+		}
+		return *this;
+	}
+
+	~delegate() {
+		reset();
+	}
+
+	explicit operator bool() const {
+		return invoker != nullptr;
+	}
+
+	R operator()(Args... args) const {
+		assert(invoker);
+		return invoker(context, std::forward<Args>(args)...);
+	}
+};
+} // namespace detail
+}
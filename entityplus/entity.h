@@ -12,19 +12,31 @@
 #include <type_traits>
 #include <array>
 #include <functional>
+#include <chrono>
 #include <cassert>
+#include <limits>
+#include <memory>
 
 #include "typelist.h"
 #include "metafunctions.h"
 #include "exception.h"
 #include "container.h"
+#include "spatial.h"
+#include "shared.h"
+#include "hierarchy.h"
 
 namespace entityplus {
+// Storage engines for entity_manager. The default keeps one container per component,
+// archetype_storage keeps one table per distinct set of components and tags.
+struct per_component_storage {};
+struct archetype_storage {};
+
 // Safety classes so that you can only create using the proper list types
-template <typename Components, typename Tags>
+template <typename Components, typename Tags, typename Singletons = singleton_list<>,
+	typename Storage = per_component_storage>
 class entity_manager {
-	static_assert(meta::delay_v<Components, Tags>,
-				  "The template parameters must be of type component_list and tag_list");
+	static_assert(meta::delay_v<Components, Tags, Singletons, Storage>,
+				  "The template parameters must be of type component_list, tag_list, singleton_list and a storage engine");
 };
 
 enum class entity_status {
@@ -37,28 +49,46 @@ enum class entity_status {
 template <typename...>
 class event_manager;
 
+// Specialize as std::false_type to compile out the entity manager's broadcasts of Event, e.g.
+// template <typename Entity, typename Component>
+// struct entity_event_traits<component_added<Entity, Component>> : std::false_type {};
+template <typename Event>
+struct entity_event_traits : std::true_type {};
+
 namespace detail {
 template <typename Components, typename Tags>
 class entity_event_manager;
 
-template <typename Components, typename Tags>
+// Lets the event managers read an entity's id and bits
+struct entity_access;
+
+template <typename Entity, typename EntityIter, typename Key, typename Iters>
+class query_iterator;
+
+template <typename Entity, typename Component>
+class component_handle;
+
+template <typename Components, typename Tags, typename Storage = per_component_storage>
 class entity {
 	static_assert(meta::delay_v<Components, Tags>,
 				  "Don't create entities manually, use entity_manager::entity_t or create_entity() instead");
 };
 
-template <typename... Components, typename... Tags>
-class entity<component_list<Components...>, tag_list<Tags...>> {
+template <typename... Components, typename... Tags, typename Storage>
+class entity<component_list<Components...>, tag_list<Tags...>, Storage> {
 public:
 	using component_list_t = component_list<Components...>;
 	using tag_list_t = tag_list<Tags...>;
-	using entity_manager_t = entity_manager<component_list_t, tag_list_t>;
+	using entity_manager_t = entity_manager<component_list_t, tag_list_t, singleton_list<>, Storage>;
 private:
 	using component_t = meta::typelist<Components...>;
 	using tag_t = meta::typelist<Tags...>;
 	using comp_tag_t = meta::typelist<Components..., Tags...>;
 
 	friend entity_manager_t;
+	template <typename, typename, typename, typename>
+	friend class query_iterator;
+	friend struct entity_access;
 	struct private_access {
 		explicit private_access() {}
 	};
@@ -82,7 +112,7 @@ public:
 
 	// Adds the component if it doesn't exist, otherwise returns the existing component
 	template <typename Component, typename... Args>
-	std::pair<Component&, bool> add_component(Args&&... args);
+	std::pair<detail::component_reference_t<Component>, bool> add_component(Args&&... args);
 
 	// Adds the component if it doesn't exist, otherwise returns the existing component
 	template <typename Component>
@@ -96,13 +126,15 @@ public:
 
 	// Must have component in order to get it, otherwise you have a invalid_component exception
 	template <typename Component>
-	const Component& get_component() const;
+	detail::component_const_reference_t<Component> get_component() const;
 	// Must have component in order to get it, otherwise you have a invalid_component exception
 	template <typename Component>
-	Component& get_component() {
-		return const_cast<Component&>
-			(meta::as_const(*this).template get_component<Component>());
-	}
+	detail::component_reference_t<Component> get_component();
+
+	// Same as get_component, but the returned handle skips the lookup on later accesses until
+	// Component storage changes. Must have component, otherwise you have a invalid_component exception
+	template <typename Component>
+	component_handle<entity, Component> get_handle();
 
 	template <typename Tag>
 	bool has_tag() const;
@@ -132,13 +164,114 @@ public:
 	}
 };
 
+// Remembers where a component is stored, only looking it up again after its storage changed
+template <typename Entity, typename Component>
+class component_handle {
+	using entity_manager_t = typename Entity::entity_manager_t;
+	using iterator = typename Entity::component_list_t::template container_type<Component>::iterator;
+
+	friend entity_manager_t;
+
+	Entity entity;
+	entity_manager_t *entityManager = nullptr;
+	iterator comp;
+	std::size_t version = 0;
+
+	component_handle(const Entity &entity, entity_manager_t *entityManager, iterator comp, std::size_t version)
+		: entity(entity), entityManager(entityManager), comp(comp), version(version) {}
+public:
+	component_handle() = default;
+
+	bool is_valid() const {
+		return entityManager != nullptr;
+	}
+
+	const Entity & get_entity() const {
+		return entity;
+	}
+
+	// Throws invalid_component if the entity lost Component or was destroyed since
+	component_reference_t<Component> get() {
+		assert(entityManager);
+		auto currVersion = entityManager->template storage_version<Component>();
+		if (version != currVersion) {
+			comp = entityManager->template find_component<Component>(entity);
+			version = currVersion;
+		}
+		return comp->second;
+	}
+
+	component_reference_t<Component> operator*() {
+		return get();
+	}
+};
+
 using entity_grouping_id_t = std::uintmax_t;
 } // namespace detail
 
 class entity_grouping;
 
+// Where a for_each_budgeted left off
+class iteration_cursor {
+	template <typename, typename, typename, typename>
+	friend class entity_manager;
+
+	detail::entity_id_t nextId = 0;
+public:
+	bool at_start() const {
+		return nextId == 0;
+	}
+
+	void reset() {
+		nextId = 0;
+	}
+};
+
+// Components and tags captured once, entity_manager::instantiate copies them onto new entities
+template <typename Components, typename Tags>
+class prefab {
+	static_assert(meta::delay_v<Components, Tags>,
+				  "Don't create prefabs manually, use entity_manager::prefab_t or create_prefab() instead");
+};
+
+template <typename... Components, typename... Tags>
+class prefab<component_list<Components...>, tag_list<Tags...>> {
+	using component_t = meta::typelist<Components...>;
+	using tag_t = meta::typelist<Tags...>;
+	using comp_tag_t = meta::typelist<Components..., Tags...>;
+
+	template <typename, typename, typename, typename>
+	friend class entity_manager;
+
+	meta::type_bitset<comp_tag_t> compTags;
+	// Copies of a prefab share the values, which never change after capture
+	std::tuple<std::shared_ptr<const Components>...> values;
+public:
+	prefab() = default;
+
+	template <typename Component>
+	bool has_component() const {
+		static_assert(meta::typelist_has_type_v<Component, component_t>,
+					  "has_component called with invalid component");
+		return meta::get<Component>(compTags);
+	}
+
+	// Must have component
+	template <typename Component>
+	const Component & get_component() const {
+		assert(has_component<Component>());
+		return *std::get<std::shared_ptr<const Component>>(values);
+	}
+
+	template <typename Tag>
+	bool has_tag() const {
+		static_assert(meta::typelist_has_type_v<Tag, tag_t>, "has_tag called with invalid tag");
+		return meta::get<Tag>(compTags);
+	}
+};
+
 template <typename... Components, typename... Tags>
-class entity_manager<component_list<Components...>, tag_list<Tags...>> {
+class entity_manager<component_list<Components...>, tag_list<Tags...>, singleton_list<>> {
 public:
 	using component_list_t = component_list<Components...>;
 	using tag_list_t = tag_list<Tags...>;
@@ -152,6 +285,8 @@ private:
 
 	friend entity_t;
 	friend entity_grouping;
+	template <typename, typename>
+	friend class detail::component_handle;
 
 	static_assert(meta::is_typelist_unique_v<comp_tag_t>,
 				  "component_list and tag_list must not intersect");
@@ -161,13 +296,21 @@ private:
 	constexpr static auto CompTagCount = ComponentCount + TagCount;
 
 	detail::entity_id_t currentEntityId = 0;
+	// Declared before components so the pools outlive the handles
+	std::tuple<typename detail::shared_traits<Components>::pool_type...> sharedPools;
 	typename component_list_t::type components;
 	entity_container entities;
 	std::size_t maxLinearSearchDistance = 64;
 	const entity_event_manager_t *eventManager = nullptr;
-	detail::entity_grouping_id_t currentGroupingId = CompTagCount;
+	detail::entity_grouping_id_t currentGroupingId = ComponentCount;
 	flat_map<detail::entity_grouping_id_t, 
 		std::pair<meta::type_bitset<comp_tag_t>, entity_container>> groupings;
+	// A bit per entity for each tag, indexed by the entity's position in entities
+	std::array<bit_vector, TagCount> tagBitmaps;
+	// Bumped whenever a component storage adds, removes or moves values, which invalidates handles
+	std::array<std::size_t, ComponentCount> storageVersions{};
+	std::tuple<detail::spatial_index<Components>...> spatialIndices;
+	detail::hierarchy hierarchy;
 
 	[[noreturn]] void report_error(error_code_t errCode, const char * error) const;
 
@@ -181,7 +324,7 @@ private:
 #endif
 
 	template <typename Component, typename... Args>
-	std::pair<Component&, bool> add_component(entity_t &entity, std::tuple<Args...> &&args);
+	std::pair<detail::component_reference_t<Component>, bool> add_component(entity_t &entity, std::tuple<Args...> &&args);
 
 	template <typename... Ts>
 	void add_components(entity_t &entity, Ts&&... ts) {
@@ -194,8 +337,32 @@ private:
 	template <typename Component>
 	bool remove_component(entity_t &entity);
 
+	// Reports an error if entity doesn't have Component
+	template <typename Component>
+	void require_component(const entity_t &entity) const;
+
+	template <typename Component>
+	detail::component_const_reference_t<Component> get_component(const entity_t &entity) const;
+
+	template <typename Component>
+	detail::component_reference_t<Component> get_component(const entity_t &entity);
+
+	template <typename Component>
+	std::size_t storage_version() const {
+		return storageVersions[meta::typelist_index_v<Component, component_t>];
+	}
+
 	template <typename Component>
-	const Component& get_component(const entity_t &entity) const;
+	void touch_storage() {
+		++storageVersions[meta::typelist_index_v<Component, component_t>];
+	}
+
+	// Reports an error if Component isn't stored for entity
+	template <typename Component>
+	auto find_component(const entity_t &entity);
+
+	template <typename Component>
+	detail::component_handle<entity_t, Component> get_handle(const entity_t &entity);
 
 	template <typename Tag>
 	bool set_tag(entity_t &entity, bool set);
@@ -209,13 +376,59 @@ private:
 	template <typename T>
 	void add_bit(entity_t &local, entity_t &foreign);
 
+	std::size_t slot_of(const entity_t &local) const {
+		return static_cast<std::size_t>(&local - &*entities.begin());
+	}
+
+	template <typename T>
+	void set_tag_bit(const entity_t &local, bool set, std::true_type) {
+		tagBitmaps[meta::typelist_index_v<T, tag_t>].set(slot_of(local), set);
+	}
+	template <typename T>
+	void set_tag_bit(const entity_t &, bool, std::false_type) {}
+
 	template <typename T>
 	void remove_bit(entity_t &local, entity_t &foreign);
 
 	bool sync(entity_t &entity) const;
 
+	typename entity_container::const_iterator find_entity(detail::entity_id_t id) const {
+		return std::lower_bound(entities.begin(), entities.end(), id,
+								[](const entity_t &ent, detail::entity_id_t id) { return ent.id < id; });
+	}
+
+	// Checked before building Event, so that nothing is done for events nobody listens to
+	template <typename Event>
+	bool wants_event() const {
+		return entity_event_traits<Event>::value && eventManager && eventManager->template is_active<Event>();
+	}
+
+	// Everything a destroyed entity's subscribers hear about, before anything is removed
+	void broadcast_destroyed(const entity_t &entity);
+
+	// Bulk operations broadcast one batch per event type, so that batch subscribers get every
+	// entity in a single call
+	template <typename Event, typename Ents>
+	void broadcast_entity_batch(const Ents &ents);
+
+	template <template <typename, typename> class Event, typename Tag, typename Ents>
+	void broadcast_tag_batch(const Ents &ents);
+
+	// ents must be in id order
+	template <template <typename, typename> class Event, typename Component, typename Ents>
+	void broadcast_component_batch(const Ents &ents);
+
+	template <typename Ents>
+	void broadcast_added_batches(const Ents &ents);
+
+	template <typename Ents>
+	void broadcast_removed_batches(const Ents &ents);
+
 	void destroy_entity(const entity_t &entity);
 
+	// Removes the entities in one pass over each container instead of one pass per entity
+	void destroy_entities(const std::vector<detail::entity_id_t> &ids);
+
 	void destroy_grouping(detail::entity_grouping_id_t id) {
 		auto er = groupings.erase(id);
 		(void)er; assert(er == 1);
@@ -223,8 +436,65 @@ private:
 
 	template <typename... Ts>
 	std::pair<entity_container&, bool> get_smallest_container();
+
+	// Calls func(candidates, isExact) with the cheapest range of entities from firstId on to
+	// check for Ts..., either part of a grouping or the entities set in every tag bitmap
+	template <typename... Ts, typename Func>
+	decltype(auto) visit_candidates(detail::entity_id_t firstId, Func &&func);
+
+	// Returns false if func or stop ended the iteration early
+	template <typename... Ts, typename Container, typename Func, typename Cond, typename Stop>
+	bool for_each_in(Container &container, bool isExact, Func &&func, Cond withControl, Stop &&stop);
+
+	template <typename... Ts, typename Stop, typename Func>
+	bool for_each_budgeted_impl(iteration_cursor &cursor, Stop &&stop, Func &&func);
+
+	// Iterates in the storage order of Leader if it was sorted, returns false otherwise
+	template <typename... Ts, typename Func, typename Cond>
+	bool for_each_ordered(Func &&, Cond, meta::typelist<> *) {
+		return false;
+	}
+	template <typename... Ts, typename Func, typename Cond, typename Leader, typename... Rest>
+	bool for_each_ordered(Func &&func, Cond withControl, meta::typelist<Leader, Rest...> *);
+
+	template <typename... Followers, typename Container>
+	void arrange_followers(const Container &leader) {
+		(void)leader;
+		std::initializer_list<int> _ =
+		{((void)meta::get<Followers, component_list_t>(components).arrange_like(leader),
+		  touch_storage<Followers>(), 0)...};
+	}
+
+	template <typename Component>
+	detail::spatial_index<Component> & get_spatial_index() {
+		return std::get<detail::spatial_index<Component>>(spatialIndices);
+	}
+
+	template <typename Component>
+	auto & get_shared_pool() {
+		return std::get<meta::typelist_index_v<Component, component_t>>(sharedPools);
+	}
+	template <typename Component>
+	void reserve_component(std::size_t count);
 public:
 	using return_container = std::vector<entity_t>;
+	using prefab_t = prefab<component_list_t, tag_list_t>;
+	template <typename Component>
+	using component_handle = detail::component_handle<entity_t, Component>;
+
+	struct memory_stats_t {
+		container_stats entities;
+		// All the tag bitmaps together
+		container_stats tags;
+		// In component_list order
+		std::array<container_stats, ComponentCount> components;
+		// The groupings of each component in component_list order, followed by the ones from
+		// create_grouping in the order they were created
+		std::vector<container_stats> groupings;
+
+		std::size_t total_bytes() const;
+		std::size_t total_slack() const;
+	};
 
 	entity_manager();
 	entity_manager(const entity_manager &) = delete;
@@ -233,6 +503,21 @@ public:
 	template <typename... Ts, typename... Us>
 	entity_t create_entity(Us&&... us);
 
+	// Captures the components given and the tags Ts, like create_entity would give them
+	template <typename... Ts, typename... Us>
+	prefab_t create_prefab(Us&&... us) const;
+
+	// Captures a copy of the components and tags entity has
+	prefab_t make_prefab(const entity_t &entity) const;
+
+	// Creates count entities holding copies of the components and tags of prefab. Each storage
+	// and grouping is appended to once, events are broadcast after every entity is in place.
+	return_container instantiate(const prefab_t &prefab, std::size_t count);
+
+	// Creates an entity holding copies of the components and tags of entity. It doesn't
+	// take entity's place in the hierarchy.
+	entity_t clone(const entity_t &entity);
+
 	// Gets all entities that have the components and tags provided
 	template <typename... Ts>
 	return_container get_entities();
@@ -240,9 +525,101 @@ public:
 	template <typename... Ts, typename Func>
 	void for_each(Func && func);
 
+	// Lazy range over the entities for_each<Ts...> would visit, in id order. Dereferencing
+	// yields a std::tuple<const entity_t &, Components &...>
+	template <typename... Ts>
+	auto query();
+
+	// Same as for_each, but stops after maxEntities and continues from there next call.
+	// Returns true once the pass over all the entities is complete.
+	template <typename... Ts, typename Func>
+	bool for_each_budgeted(iteration_cursor &cursor, std::size_t maxEntities, Func &&func);
+
+	// Same as for_each, but stops once deadline passes and continues from there next call.
+	// Returns true once the pass over all the entities is complete.
+	template <typename... Ts, typename Func>
+	bool for_each_budgeted(iteration_cursor &cursor, std::chrono::steady_clock::time_point deadline, Func &&func);
+
+	// Hands func the values of a struct of arrays Component, chunkSize at a time, each field
+	// as its own span. Chunks follow storage order rather than entity order.
+	template <typename Component, typename Func>
+	void for_each_chunk(std::size_t chunkSize, Func &&func);
+
 	template <typename... Ts>
 	entity_grouping create_grouping();
 
+	// Orders Component storage by cmp, Followers are arranged to match it.
+	// for_each follows this order when Component is its first component.
+	template <typename Component, typename... Followers, typename Compare>
+	void sort(Compare &&cmp);
+
+	// Same as sort, but cheaper when the storage is already nearly sorted
+	template <typename Component, typename... Followers, typename Compare>
+	void insertion_sort(Compare &&cmp);
+
+	// Indexes Component in a uniform grid, extractor maps a Component to its position
+	template <typename Component, typename Extractor>
+	void create_spatial_index(float cellSize, Extractor &&extractor);
+
+	template <typename Component>
+	void destroy_spatial_index();
+
+	// Must be called after changing the position of a spatially indexed component
+	template <typename Component>
+	void update_spatial_index(const entity_t &entity);
+
+	// Refreshes the position of every indexed Component
+	template <typename Component>
+	void update_spatial_index();
+
+	// Like for_each<Component, Ts...>, but only for entities whose Component is within radius of center
+	template <typename Component, typename... Ts, typename Func>
+	void for_each_within(const spatial_point &center, float radius, Func &&func);
+
+	// Returns the k closest entities for each center, closest first
+	template <typename Component>
+	std::vector<return_container> get_nearest(const std::vector<spatial_point> &centers, std::size_t k);
+
+	// Makes parent the parent of child, child and its descendants move along with it.
+	// Reports an error if parent is child or one of its descendants.
+	void set_parent(const entity_t &child, const entity_t &parent);
+
+	// Makes child a root again, returns false if it didn't have a parent
+	bool clear_parent(const entity_t &child);
+
+	// Returns an uninitialized entity if child doesn't have a parent
+	entity_t get_parent(const entity_t &child) const;
+
+	return_container get_children(const entity_t &parent) const;
+
+	// Destroys entity along with all of its descendants
+	void destroy_with_children(const entity_t &entity);
+
+	// Destroys every entity in one pass over each container, keeping their memory for reuse.
+	// Groupings and spatial indices stay, but are emptied. With resetIds, ids start from 0
+	// again, so entities kept from before may compare equal to new ones.
+	void clear(bool broadcastEvents = true, bool resetIds = false);
+
+	// Visits the entities with all of Ts in the hierarchy, parents before their children. func
+	// gets the entity, its Ts and pointers to the parent's Ts, which are null for roots and for
+	// parents that don't have all of Ts.
+	template <typename... Ts, typename Func>
+	void for_each_topdown(Func &&func);
+
+	// Number of distinct values held by a shared<T> component
+	template <typename Component>
+	std::size_t shared_value_count() const;
+
+	// Makes room for entityCount entities, and for as many of each of Ts as the count given
+	// for it, e.g. reserve<position, sprite>(1000, 1000, 200)
+	template <typename... Ts, typename... Counts>
+	void reserve(std::size_t entityCount, Counts... componentCounts);
+
+	// Gives back the memory left unused after entities or components went away
+	void shrink_to_fit();
+
+	memory_stats_t memory_stats() const;
+
 	std::size_t get_max_linear_dist() const {
 		return maxLinearSearchDistance;
 	}
@@ -278,6 +655,46 @@ struct control_block_t {
 	bool breakout = false;
 };
 
+// Singletons are stored once, inline in the manager, and don't belong to any entity
+template <typename... Components, typename... Tags, typename... Singletons, typename Storage>
+class entity_manager<component_list<Components...>, tag_list<Tags...>, singleton_list<Singletons...>, Storage>
+	: public entity_manager<component_list<Components...>, tag_list<Tags...>, singleton_list<>, Storage> {
+	using base_t = entity_manager<component_list<Components...>, tag_list<Tags...>, singleton_list<>, Storage>;
+	using comp_tag_t = meta::typelist<Components..., Tags...>;
+	using singleton_t = meta::typelist<Singletons...>;
+
+	static_assert(meta::is_typelist_unique_v<meta::typelist<Components..., Tags..., Singletons...>>,
+				  "singleton_list must not intersect component_list or tag_list");
+
+	std::tuple<Singletons...> singletons;
+
+	template <typename ParamsPart, typename... Ts, typename... Ss, typename Func>
+	void for_each_impl(Func &&func, meta::typelist<Ts...> *, meta::typelist<Ss...> *);
+public:
+	using typename base_t::entity_t;
+
+	entity_manager() = default;
+
+	template <typename Singleton>
+	Singleton& singleton() {
+		static_assert(meta::typelist_has_type_v<Singleton, singleton_t>,
+					  "singleton called with invalid singleton");
+		return std::get<Singleton>(singletons);
+	}
+
+	template <typename Singleton>
+	const Singleton& singleton() const {
+		static_assert(meta::typelist_has_type_v<Singleton, singleton_t>,
+					  "singleton called with invalid singleton");
+		return std::get<Singleton>(singletons);
+	}
+
+	// Same as entity_manager::for_each, but Ts may also name singletons. They are passed to
+	// func in the order of Ts and don't affect which entities are visited.
+	template <typename... Ts, typename Func>
+	void for_each(Func &&func);
+};
+
 class entity_grouping {
 	detail::entity_grouping_id_t id;
 	void *manager = nullptr;
@@ -324,3 +741,4 @@ public:
 }
 
 #include "entity.impl"
+#include "archetype.h"
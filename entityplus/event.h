@@ -7,12 +7,21 @@
 
 #include <tuple>
 #include <type_traits>
-#include <functional>
 #include <cassert>
+#include <limits>
+#include <vector>
+#include <bitset>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <exception>
 
 #include "metafunctions.h"
 #include "container.h"
 #include "typelist.h"
+#include "delegate.h"
 #include "entity.h"
 
 namespace entityplus {
@@ -48,15 +57,503 @@ struct tag_removed {
 	Entity entity;
 };
 
+// Contiguous run of events handed to batch subscribers
+template <typename Event>
+class event_span {
+	const Event *first;
+	std::size_t count;
+public:
+	event_span(const Event *first, std::size_t count) : first(first), count(count) {}
+
+	const Event * begin() const { return first; }
+	const Event * end() const { return first + count; }
+	const Event * data() const { return first; }
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const Event & operator[](std::size_t idx) const {
+		assert(idx < count);
+		return first[idx];
+	}
+};
+
+template <typename... Events>
+class event_journal;
+
 namespace detail {
 using subscriber_handle_id_t = std::uintmax_t;
 
 template <typename T>
 using event_sig_t = void(const T &);
 template <typename T>
-using event_func_t = std::function<event_sig_t<T>>;
+using event_func_t = delegate<event_sig_t<T>>;
+template <typename T>
+using event_batch_func_t = delegate<void(event_span<T>)>;
+// Subscribers are called in the order they subscribed, straight from contiguous storage
 template <typename T>
 using event_queue_t = flat_map<subscriber_handle_id_t, event_func_t<T>>;
+template <typename T>
+using event_batch_queue_t = flat_map<subscriber_handle_id_t, event_batch_func_t<T>>;
+
+// Queued events are copies, component events keep a copy of the component instead of the reference
+template <typename T>
+struct is_queueable : std::is_copy_constructible<T> {};
+
+template <typename Entity, typename Component>
+struct is_queueable<component_added<Entity, Component>> : std::is_copy_constructible<Component> {};
+
+template <typename Entity, typename Component>
+struct is_queueable<component_removed<Entity, Component>> : std::is_copy_constructible<Component> {};
+
+// Events waiting for dispatch. take() hands out everything pushed so far, which stays valid
+// until the next take(), so events pushed while a batch is being handled wait for the next one.
+template <typename T>
+class event_buffer {
+	std::vector<T> pending, draining;
+public:
+	bool empty() const {
+		return pending.empty();
+	}
+
+	void push(const T &event) {
+		pending.push_back(event);
+	}
+
+	void append(std::vector<T> &events) {
+		pending.insert(pending.end(), std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()));
+	}
+
+	event_span<T> take() {
+		draining.clear();
+		std::swap(pending, draining);
+		return {draining.data(), draining.size()};
+	}
+};
+
+template <typename Event, typename Entity, typename Component>
+class component_event_buffer {
+	std::vector<Entity> entities, drainingEntities;
+	std::vector<Component> components, drainingComponents;
+	std::vector<Event> events;
+public:
+	bool empty() const {
+		return entities.empty();
+	}
+
+	void push(const Event &event) {
+		entities.push_back(event.entity);
+		components.push_back(event.component);
+	}
+
+	event_span<Event> take() {
+		drainingEntities.clear();
+		drainingComponents.clear();
+		std::swap(entities, drainingEntities);
+		std::swap(components, drainingComponents);
+		events.clear();
+		events.reserve(drainingEntities.size());
+		for (std::size_t i = 0; i < drainingEntities.size(); ++i) {
+			events.push_back(Event{drainingEntities[i], drainingComponents[i]});
+		}
+		return {events.data(), events.size()};
+	}
+};
+
+template <typename Entity, typename Component>
+class event_buffer<component_added<Entity, Component>>
+	: public component_event_buffer<component_added<Entity, Component>, Entity, Component> {};
+
+template <typename Entity, typename Component>
+class event_buffer<component_removed<Entity, Component>>
+	: public component_event_buffer<component_removed<Entity, Component>, Entity, Component> {};
+
+// Targets of a channel whose events aren't about entities
+struct no_targets {
+	bool empty() const {
+		return true;
+	}
+
+	template <typename T>
+	void deliver(event_span<T>) const {}
+
+	std::size_t unsubscribe(subscriber_handle_id_t) {
+		return 0;
+	}
+};
+
+struct entity_access {
+	template <typename Entity>
+	static entity_id_t id(const Entity &entity) {
+		return entity.id;
+	}
+
+	template <typename Entity>
+	static bool has_bit(const Entity &entity, std::size_t idx) {
+		return entity.compTags[idx];
+	}
+};
+
+// Subscribers of a single entity, or of the entities with a tag, which only get the events
+// they're interested in
+template <typename T>
+class entity_targets {
+	struct target {
+		bool isTag;
+		// Entity id, or the tag's index among the entity's components and tags
+		entity_id_t key;
+	};
+
+	flat_map<entity_id_t, event_queue_t<T>> byEntity;
+	flat_map<entity_id_t, event_queue_t<T>> byTag;
+	// Where every subscriber is, so that unsubscribing doesn't search
+	flat_map<subscriber_handle_id_t, target> targets;
+
+	template <typename Func>
+	void add(subscriber_handle_id_t id, target where, Func &&func) {
+		auto &subs = where.isTag ? byTag : byEntity;
+		auto found = subs.find(where.key);
+		if (found == subs.end()) found = subs.emplace(where.key, event_queue_t<T>{}).first;
+		found->second.emplace(id, std::forward<Func>(func));
+		targets.emplace(id, where);
+	}
+public:
+	bool empty() const {
+		return targets.empty();
+	}
+
+	template <typename Func>
+	void subscribe_entity(subscriber_handle_id_t id, const decltype(std::declval<T>().entity) &entity, Func &&func) {
+		add(id, target{false, entity_access::id(entity)}, std::forward<Func>(func));
+	}
+
+	template <typename Func>
+	void subscribe_tag(subscriber_handle_id_t id, std::size_t tagIdx, Func &&func) {
+		add(id, target{true, tagIdx}, std::forward<Func>(func));
+	}
+
+	// Each event costs a lookup of its entity and a check per tag with subscribers
+	void deliver(event_span<T> events) const {
+		if (targets.empty()) return;
+		for (const auto &event : events) {
+			auto found = byEntity.find(entity_access::id(event.entity));
+			if (found != byEntity.end()) {
+				for (const auto &sub : found->second) sub.second(event);
+			}
+			for (const auto &tagSubs : byTag) {
+				if (!entity_access::has_bit(event.entity, tagSubs.first)) continue;
+				for (const auto &sub : tagSubs.second) sub.second(event);
+			}
+		}
+	}
+
+	std::size_t unsubscribe(subscriber_handle_id_t id) {
+		auto owner = targets.find(id);
+		if (owner == targets.end()) return 0;
+		auto &subs = owner->second.isTag ? byTag : byEntity;
+		auto found = subs.find(owner->second.key);
+		found->second.erase(id);
+		if (found->second.empty()) subs.erase(found);
+		targets.erase(owner);
+		return 1;
+	}
+};
+
+// Net change of one component type on every entity since the last flush. A removal cancels an
+// addition from the same frame, otherwise the first removed and the last added value are kept.
+template <typename Entity, typename Component>
+class component_changelog {
+	static constexpr auto none = std::numeric_limits<std::size_t>::max();
+
+	struct change {
+		Entity entity;
+		// Indices into values
+		std::size_t removed, added;
+	};
+
+	flat_map<entity_id_t, change> changes;
+	// Handlers may record new changes while the flushed values are delivered
+	std::vector<Component> values, flushedValues;
+	std::vector<component_removed<Entity, Component>> removedEvents;
+	std::vector<component_added<Entity, Component>> addedEvents;
+
+	change & find_change(const Entity &entity) {
+		auto id = entity_access::id(entity);
+		auto found = changes.find(id);
+		if (found == changes.end()) found = changes.emplace(id, change{entity, none, none}).first;
+		found->second.entity = entity;
+		return found->second;
+	}
+public:
+	void added(const Entity &entity, const Component &component) {
+		find_change(entity).added = values.size();
+		values.push_back(component);
+	}
+
+	void removed(const Entity &entity, const Component &component) {
+		auto &entry = find_change(entity);
+		if (entry.added != none) {
+			entry.added = none;
+			if (entry.removed == none) changes.erase(entity_access::id(entity));
+			return;
+		}
+		entry.removed = values.size();
+		values.push_back(component);
+	}
+
+	// Removals are delivered before additions, each in entity order
+	template <typename RemovedChannel, typename AddedChannel>
+	void flush(const RemovedChannel &removedChannel, const AddedChannel &addedChannel) {
+		if (changes.empty()) return;
+		flushedValues.clear();
+		std::swap(values, flushedValues);
+		removedEvents.clear();
+		addedEvents.clear();
+		for (const auto &entry : changes) {
+			const auto &c = entry.second;
+			if (c.removed != none) removedEvents.push_back({c.entity, flushedValues[c.removed]});
+			if (c.added != none) addedEvents.push_back({c.entity, flushedValues[c.added]});
+		}
+		changes.clear();
+		removedChannel.deliver({removedEvents.data(), removedEvents.size()});
+		addedChannel.deliver({addedEvents.data(), addedEvents.size()});
+	}
+};
+
+// Net change of one tag on every entity since the last flush, setting and then unsetting it
+// cancels out either way
+template <typename Entity, typename Tag>
+class tag_changelog {
+	struct change {
+		Entity entity;
+		bool set;
+	};
+
+	flat_map<entity_id_t, change> changes;
+	std::vector<tag_removed<Entity, Tag>> removedEvents;
+	std::vector<tag_added<Entity, Tag>> addedEvents;
+
+	void toggle(const Entity &entity, bool set) {
+		auto id = entity_access::id(entity);
+		auto found = changes.find(id);
+		if (found == changes.end()) changes.emplace(id, change{entity, set});
+		else changes.erase(found);
+	}
+public:
+	void added(const Entity &entity) {
+		toggle(entity, true);
+	}
+
+	void removed(const Entity &entity) {
+		toggle(entity, false);
+	}
+
+	template <typename RemovedChannel, typename AddedChannel>
+	void flush(const RemovedChannel &removedChannel, const AddedChannel &addedChannel) {
+		if (changes.empty()) return;
+		removedEvents.clear();
+		addedEvents.clear();
+		for (const auto &entry : changes) {
+			if (entry.second.set) addedEvents.push_back({entry.second.entity});
+			else removedEvents.push_back({entry.second.entity});
+		}
+		changes.clear();
+		removedChannel.deliver({removedEvents.data(), removedEvents.size()});
+		addedChannel.deliver({addedEvents.data(), addedEvents.size()});
+	}
+};
+
+// Everyone listening to one event type, replaced rather than changed while it's being delivered to
+template <typename T, typename Targets>
+struct subscriber_lists {
+	event_queue_t<T> subscribers;
+	event_batch_queue_t<T> batchSubscribers;
+	// Subscribers that dispatch_parallel may run on other threads
+	flat_set<subscriber_handle_id_t> parallelSubscribers;
+	// Called after the rest
+	Targets targets;
+
+	bool empty() const {
+		return subscribers.empty() && batchSubscribers.empty() && targets.empty();
+	}
+};
+
+// Everything the event managers keep per event type
+template <typename T, typename Targets = no_targets>
+class event_channel {
+	using lists_t = subscriber_lists<T, Targets>;
+
+	// Keeps the lists a delivery started with alive until the outermost delivery is done
+	class delivery_guard {
+		const event_channel &channel;
+	public:
+		explicit delivery_guard(const event_channel &channel) : channel(channel) {
+			++channel.deliveries;
+			channel.pinned = true;
+		}
+
+		~delivery_guard() {
+			if (--channel.deliveries != 0) return;
+			channel.retired.clear();
+			channel.pinned = false;
+		}
+	};
+
+	std::unique_ptr<lists_t> lists = std::make_unique<lists_t>();
+	mutable std::vector<std::unique_ptr<lists_t>> retired;
+	mutable std::size_t deliveries = 0;
+	// Set while a delivery may be reading lists, changing them then takes a copy
+	mutable bool pinned = false;
+
+	void push(const T &event, std::true_type) const {
+		buffer.push(event);
+	}
+
+	void push(const T &, std::false_type) const {
+		assert(false && "event can't be queued");
+	}
+
+	void append(std::vector<T> &events, std::true_type) {
+		buffer.append(events);
+	}
+
+	void append(std::vector<T> &events, std::false_type) {
+		(void)events; assert(events.empty() && "event can't be queued");
+	}
+public:
+	// Filled through the const broadcast of the entity manager
+	mutable event_buffer<T> buffer;
+	bool queued = false;
+	// Set by an attached event_journal, sees every event broadcast or enqueued
+	event_func_t<T> recorder;
+
+	using event_type = T;
+
+	const lists_t & get_lists() const {
+		return *lists;
+	}
+
+	// Subscribers changed during a delivery, including by the subscribers themselves, take effect
+	// from the next one
+	lists_t & modify_lists() {
+		if (pinned) {
+			auto copy = std::make_unique<lists_t>(*lists);
+			retired.push_back(std::move(lists));
+			lists = std::move(copy);
+			pinned = false;
+		}
+		return *lists;
+	}
+
+	// Handlers and batch handlers are interleaved in the order they subscribed
+	void deliver(event_span<T> events, bool skipParallel = false) const {
+		delivery_guard guard(*this);
+		const auto &current = *lists;
+		auto sub = current.subscribers.begin(), subEnd = current.subscribers.end();
+		auto batchSub = current.batchSubscribers.begin(), batchEnd = current.batchSubscribers.end();
+		while (sub != subEnd || batchSub != batchEnd) {
+			if (batchSub == batchEnd || (sub != subEnd && sub->first < batchSub->first)) {
+				if (!skipParallel || current.parallelSubscribers.find(sub->first) == current.parallelSubscribers.end()) {
+					for (const auto &event : events) sub->second(event);
+				}
+				++sub;
+			}
+			else {
+				batchSub->second(events);
+				++batchSub;
+			}
+		}
+		current.targets.deliver(events);
+	}
+
+	// Parallel subscribers are shared out between threadCount threads, including this one, which
+	// first calls the other subscribers in order. The first exception thrown is rethrown at the end.
+	void deliver_parallel(event_span<T> events, std::size_t threadCount) const {
+		delivery_guard guard(*this);
+		const auto &current = *lists;
+		std::vector<const event_func_t<T> *> parallel;
+		for (auto id : current.parallelSubscribers) parallel.push_back(&current.subscribers.find(id)->second);
+
+		std::atomic<std::size_t> next{0};
+		std::atomic<bool> failed{false};
+		std::exception_ptr error;
+		auto fail = [&] {
+			if (!failed.exchange(true)) error = std::current_exception();
+		};
+		// A subscriber that throws doesn't keep the others from running
+		auto work = [&] {
+			for (auto idx = next++; idx < parallel.size(); idx = next++) {
+				try {
+					for (const auto &event : events) (*parallel[idx])(event);
+				}
+				catch (...) {
+					fail();
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		auto helperCount = std::min(std::max<std::size_t>(threadCount, 1), parallel.size());
+		for (std::size_t i = 1; i < helperCount; ++i) threads.emplace_back(work);
+		try {
+			deliver(events, true);
+		}
+		catch (...) {
+			fail();
+		}
+		work();
+		for (auto &thread : threads) thread.join();
+		if (error) std::rethrow_exception(error);
+	}
+
+	void broadcast(const T &event) const {
+		if (recorder) recorder(event);
+		route(event);
+	}
+
+	// Broadcasts without recording
+	void route(const T &event) const {
+		if (queued) push(event, is_queueable<T>{});
+		else deliver({&event, 1});
+	}
+
+	// Batch subscribers get every event in one call
+	void route_all(event_span<T> events) const {
+		if (queued) {
+			for (const auto &event : events) push(event, is_queueable<T>{});
+		}
+		else deliver(events);
+	}
+
+	void enqueue(const T &event) const {
+		if (recorder) recorder(event);
+		push(event, is_queueable<T>{});
+	}
+
+	void enqueue_all(std::vector<T> &events) {
+		if (recorder) {
+			for (const auto &event : events) recorder(event);
+		}
+		append(events, is_queueable<T>{});
+	}
+
+	void dispatch() {
+		if (buffer.empty()) return;
+		deliver(buffer.take());
+	}
+
+	std::size_t unsubscribe(subscriber_handle_id_t id) {
+		auto &current = modify_lists();
+		current.parallelSubscribers.erase(id);
+		return current.subscribers.erase(id) + current.batchSubscribers.erase(id) + current.targets.unsubscribe(id);
+	}
+};
+
+// Events one producer enqueued between two flushes, linked into the event manager's list
+template <typename... Events>
+struct producer_batch {
+	producer_batch *next = nullptr;
+	std::size_t producer = 0, sequence = 0;
+	std::tuple<std::vector<Events>...> events;
+};
 
 template <typename, typename>
 class entity_event_manager;
@@ -88,33 +585,165 @@ private:
 	static_assert(meta::is_typelist_unique_v<entity_events_t>,
 				  "Internal events not unique. Panic!");
 
-	detail::subscriber_handle_id_t currentId = 0;
-	meta::tuple_from_typelist_t<entity_events_t, event_queue_t> eventQueues;
+	using comp_tag_t = meta::typelist<Components..., Tags...>;
+
+	template <typename T>
+	using entity_channel = event_channel<T, entity_targets<T>>;
+	using channels_t = meta::tuple_from_typelist_t<entity_events_t, entity_channel>;
+
+	channels_t channels;
+	// Events with a subscriber or a queue, the entity manager doesn't build the others
+	std::bitset<std::tuple_size<channels_t>::value> activeEvents;
+	// Components and tags whose added/removed events are active
+	meta::type_bitset<comp_tag_t> activeAdded, activeRemoved;
 
 	template <typename...>
 	friend class ::entityplus::event_manager;
 
 	friend class ::entityplus::entity_manager<component_list<Components...>, tag_list<Tags...>>;
 
+	// Filled instead of broadcasting component and tag events while coalescing
+	mutable std::tuple<component_changelog<entity_t, Components>..., tag_changelog<entity_t, Tags>...> changelogs;
+	bool coalescing = false;
+
+	template <typename...>
+	friend class ::entityplus::event_journal;
+
 	template <typename Event>
 	void broadcast(const Event &event) const {
 		static_assert(meta::typelist_has_type_v<Event, entity_events_t>, "broadcast called with invalid event");
-		const auto &cont = std::get<event_queue_t<Event>>(eventQueues);
-		for (const auto &sub : cont) sub.second(event);
+		const auto &channel = std::get<entity_channel<Event>>(channels);
+		if (channel.recorder) channel.recorder(event);
+		replay(event);
 	}
 
-	template <typename Event, typename Func>
-	subscriber_handle_id_t subscribe(Func &&func) {
-		assert(std::numeric_limits<subscriber_handle_id_t>::max() != currentId);
-		auto sub = std::get<event_queue_t<Event>>(eventQueues).emplace(currentId++, std::forward<Func>(func));
-		assert(sub.second);
+	// Same as broadcasting each of events, except that batch subscribers get all of them at once
+	template <typename Event>
+	void broadcast_all(const std::vector<Event> &events) const {
+		static_assert(meta::typelist_has_type_v<Event, entity_events_t>, "broadcast called with invalid event");
+		const auto &channel = std::get<entity_channel<Event>>(channels);
+		if (channel.recorder) {
+			for (const auto &event : events) channel.recorder(event);
+		}
+		// Events of one type are either all coalesced or none are
+		if (coalescing && !events.empty() && record(events.front())) {
+			for (auto event = events.begin() + 1; event != events.end(); ++event) record(*event);
+			return;
+		}
+		channel.route_all({events.data(), events.size()});
+	}
+
+	// Broadcasts without recording
+	template <typename Event>
+	void replay(const Event &event) const {
+		if (coalescing && record(event)) return;
+		std::get<entity_channel<Event>>(channels).route(event);
+	}
+
+	// Returns false for the events that aren't coalesced
+	template <typename Event>
+	bool record(const Event &) const {
+		return false;
+	}
+
+	template <typename T>
+	bool record(const component_added_t<T> &event) const {
+		return record_component(event, true, std::is_copy_constructible<T>{});
+	}
+
+	template <typename T>
+	bool record(const component_removed_t<T> &event) const {
+		return record_component(event, false, std::is_copy_constructible<T>{});
+	}
+
+	template <typename T>
+	bool record(const tag_added_t<T> &event) const {
+		std::get<tag_changelog<entity_t, T>>(changelogs).added(event.entity);
+		return true;
+	}
+
+	template <typename T>
+	bool record(const tag_removed_t<T> &event) const {
+		std::get<tag_changelog<entity_t, T>>(changelogs).removed(event.entity);
+		return true;
+	}
+
+	template <typename Event>
+	bool record_component(const Event &event, bool added, std::true_type) const {
+		using Component = std::decay_t<decltype(event.component)>;
+		auto &changelog = std::get<component_changelog<entity_t, Component>>(changelogs);
+		if (added) changelog.added(event.entity, event.component);
+		else changelog.removed(event.entity, event.component);
+		return true;
+	}
+
+	template <typename Event>
+	bool record_component(const Event &, bool, std::false_type) const {
+		return false;
+	}
+
+	void flush_changelogs() {
+		meta::for_each(changelogs, [&](auto &changelog, std::size_t, auto) {
+			flush_changelog(changelog);
+		});
+	}
+
+	template <typename T>
+	void flush_changelog(component_changelog<entity_t, T> &changelog) {
+		changelog.flush(get_channel<component_removed_t<T>>(), get_channel<component_added_t<T>>());
+	}
+
+	template <typename T>
+	void flush_changelog(tag_changelog<entity_t, T> &changelog) {
+		changelog.flush(get_channel<tag_removed_t<T>>(), get_channel<tag_added_t<T>>());
+	}
+
+	template <typename Event>
+	bool is_active() const {
+		return activeEvents[meta::typelist_index_v<Event, entity_events_t>];
+	}
+
+	template <typename T>
+	void set_active_bits(meta::detail::type_holder<component_added_t<T>>, bool active) {
+		meta::get<T>(activeAdded) = active;
+	}
 
-		return sub.first->first;
+	template <typename T>
+	void set_active_bits(meta::detail::type_holder<component_removed_t<T>>, bool active) {
+		meta::get<T>(activeRemoved) = active;
+	}
+
+	template <typename T>
+	void set_active_bits(meta::detail::type_holder<tag_added_t<T>>, bool active) {
+		meta::get<T>(activeAdded) = active;
+	}
+
+	template <typename T>
+	void set_active_bits(meta::detail::type_holder<tag_removed_t<T>>, bool active) {
+		meta::get<T>(activeRemoved) = active;
+	}
+
+	template <typename Event>
+	void set_active_bits(meta::detail::type_holder<Event>, bool) {}
+
+	// Called whenever the subscribers of Event change, it's (un)queued or a journal is attached
+	template <typename Event>
+	void update_active() {
+		const auto &channel = get_channel<Event>();
+		bool active = entity_event_traits<Event>::value &&
+			(channel.queued || channel.recorder || !channel.get_lists().empty());
+		activeEvents[meta::typelist_index_v<Event, entity_events_t>] = active;
+		set_active_bits(meta::detail::type_holder<Event>{}, active);
 	}
 
 	template <typename Event>
-	auto unsubscribe(detail::subscriber_handle_id_t id) {
-		return std::get<event_queue_t<Event>>(eventQueues).erase(id);
+	entity_channel<Event> & get_channel() {
+		return std::get<entity_channel<Event>>(channels);
+	}
+
+	void dispatch() {
+		meta::for_each(channels, [](auto &channel, auto, auto) { channel.dispatch(); });
+		flush_changelogs();
 	}
 };
 } // namespace detail
@@ -167,6 +796,61 @@ public:
 	}
 };
 
+// Enqueues custom events from another thread. Events are kept by the producer until flush(),
+// which hands them to the event manager without locking. A producer must only be used by one
+// thread at a time, and must not outlive its event manager.
+template <typename... Events>
+class event_producer;
+
+template <typename... Components, typename... Tags, typename... Events>
+class event_producer<component_list<Components...>, tag_list<Tags...>, Events...> {
+	using manager_t = event_manager<component_list<Components...>, tag_list<Tags...>, Events...>;
+	using batch_t = detail::producer_batch<Events...>;
+
+	manager_t *manager = nullptr;
+	std::size_t id = 0, sequence = 0;
+	std::unique_ptr<batch_t> batch;
+
+	friend manager_t;
+
+	event_producer(manager_t &manager, std::size_t id) noexcept : manager(&manager), id(id) {}
+public:
+	event_producer() = default;
+	event_producer(event_producer &&) noexcept = default;
+
+	event_producer& operator=(event_producer &&other) noexcept {
+		if (this != &other) {
+			flush();
+			manager = other.manager;
+			id = other.id;
+			sequence = other.sequence;
+			batch = std::move(other.batch);
+		}
+		return *this;
+	}
+
+	~event_producer() {
+		flush();
+	}
+
+	template <typename Event>
+	void enqueue(const Event &event) {
+		static_assert(meta::typelist_has_type_v<Event, meta::typelist<Events...>>, "enqueue called with invalid event");
+		static_assert(detail::is_queueable<Event>::value, "Queued events must be copy constructible");
+		assert(manager);
+		if (!batch) batch = std::make_unique<batch_t>();
+		std::get<std::vector<Event>>(batch->events).push_back(event);
+	}
+
+	// The events are delivered by the next dispatch() of the event manager
+	void flush() {
+		if (!batch) return;
+		batch->producer = id;
+		batch->sequence = sequence++;
+		manager->publish(batch.release());
+	}
+};
+
 template <typename... Components, typename... Tags, typename... Events>
 class event_manager<component_list<Components...>, tag_list<Tags...>, Events...> {
 	using custom_events_t = meta::typelist<Events...>;
@@ -183,28 +867,110 @@ class event_manager<component_list<Components...>, tag_list<Tags...>, Events...>
 
 	friend class entity_manager<component_list<Components...>, tag_list<Tags...>>;
 
+	friend class event_producer<component_list<Components...>, tag_list<Tags...>, Events...>;
+
+	friend class event_journal<component_list<Components...>, tag_list<Tags...>, Events...>;
+
+	using producer_batch_t = detail::producer_batch<Events...>;
+
 	detail::subscriber_handle_id_t currentId = 0;
-	std::tuple<detail::event_queue_t<Events>...> eventQueues;
+	std::tuple<detail::event_channel<Events>...> channels;
 	entity_event_manager_t entityEventManager;
+	bool dispatching = false;
+	// Flushed by producers on any thread, taken all at once by dispatch()
+	std::atomic<producer_batch_t *> publishedBatches{nullptr};
+	std::atomic<std::size_t> producerCount{0};
+
+	void publish(producer_batch_t *batch);
+
+	// Moves the published events into the queues, ordered by producer and then by flush
+	void collect_published();
+
+	template <typename Event>
+	auto & get_channel();
+
+	// Lets the entity manager skip entity events nobody listens to
+	template <typename Event>
+	void update_active();
 
 	template <typename Event>
 	void unsubscribe(detail::subscriber_handle_id_t id);
 
+	// Same as broadcast, for any event, without recording it
+	template <typename Event>
+	void replay(const Event &event) const;
+
 	const auto & get_entity_event_manager() const {
 		return entityEventManager;
 	}
 public:
+	using entity_t = detail::entity<component_list<Components...>, tag_list<Tags...>>;
+	using producer_t = event_producer<component_list<Components...>, tag_list<Tags...>, Events...>;
+
 	event_manager() = default;
 	event_manager(const event_manager &) = delete;
 	event_manager& operator=(const event_manager &) = delete;
+	~event_manager();
 
+	// func is stored inline and must fit in detail::delegate_buffer_size bytes, capture a
+	// pointer to anything larger
 	template <typename Event, typename Func>
 	subscriber_handle<Event> subscribe(Func &&func);
 
+	// Calls func(context, event) for every broadcast, without wrapping func in a callable
+	template <typename Event>
+	subscriber_handle<Event> subscribe(void (*func)(void *, const Event &), void *context);
+
+	// func takes an event_span<Event>, all of the queued events at once or a single broadcast one
+	template <typename Event, typename Func>
+	subscriber_handle<Event> subscribe_batch(Func &&func);
+
+	// func is only called for the events of entity, after the other subscribers
+	template <typename Event, typename Func>
+	subscriber_handle<Event> subscribe_for(const entity_t &entity, Func &&func);
+
+	// func is only called for the events of entities with Tag, after the other subscribers
+	template <typename Event, typename Tag, typename Func>
+	subscriber_handle<Event> subscribe_with_tag(Func &&func);
+
+	// Same as subscribe, but dispatch_parallel may call func on another thread at the same time
+	// as other subscribers
+	template <typename Event, typename Func>
+	subscriber_handle<Event> subscribe_parallel(Func &&func);
+
 	template <typename Event>
 	void broadcast(const Event &event) const;
+
+	// Delivers events with the parallel subscribers spread over threadCount threads, each calling
+	// one subscriber for all of events at a time. The rest are called in order on this thread.
+	// Returns once every subscriber is done.
+	template <typename Event>
+	void dispatch_parallel(event_span<Event> events,
+						   std::size_t threadCount = std::thread::hardware_concurrency());
+
+	// Stored until the next dispatch()
+	template <typename Event>
+	void enqueue(const Event &event);
+
+	// While queued, broadcasts of Event (including the ones from the entity manager) are enqueued
+	template <typename Event>
+	void set_queued(bool queued);
+
+	// Hands every queued event to the subscribers, one event type at a time
+	void dispatch();
+
+	// While coalescing, component and tag events from the entity manager are only recorded, and
+	// dispatch() delivers the net change of every entity since the previous dispatch()
+	void set_coalescing(bool coalesce) {
+		entityEventManager.coalescing = coalesce;
+	}
+
+	// Can be called from any thread. Producers are numbered in the order they're made, and
+	// dispatch() delivers the events of lower numbered producers first.
+	producer_t make_producer();
 };
 
 }
 
 #include "event.impl"
+#include "journal.h"
@@ -13,7 +13,8 @@ namespace entityplus {
 
 enum class error_code_t {
 	BAD_ENTITY,
-	INVALID_COMPONENT
+	INVALID_COMPONENT,
+	INVALID_HIERARCHY
 };
 
 #ifndef ENTITYPLUS_NO_EXCEPTIONS
@@ -26,6 +27,10 @@ struct invalid_component : std::logic_error {
 	using std::logic_error::logic_error;
 };
 
+struct invalid_hierarchy : std::logic_error {
+	using std::logic_error::logic_error;
+};
+
 #endif
 
 }
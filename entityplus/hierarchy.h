@@ -0,0 +1,180 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cassert>
+#include <algorithm>
+
+#include "typelist.h"
+#include "container.h"
+
+namespace entityplus {
+namespace detail {
+constexpr auto no_parent = std::numeric_limits<entity_id_t>::max();
+
+// Parent links between entities, with every subtree stored contiguously in depth first order
+// so that a parent always comes before its children
+class hierarchy {
+public:
+	struct node {
+		entity_id_t id, parent;
+		// Number of nodes in the subtree, including this one
+		std::size_t size;
+	};
+private:
+	std::vector<node> nodes;
+	flat_map<entity_id_t, std::size_t> positions;
+
+	std::size_t position_of(entity_id_t id) const {
+		auto pos = positions.find(id);
+		assert(pos != positions.end());
+		return pos->second;
+	}
+
+	void update_positions(std::size_t first, std::size_t last) {
+		for (auto i = first; i < last; ++i) positions.find(nodes[i].id)->second = i;
+	}
+
+	void resize_ancestors(entity_id_t parent, std::size_t count, bool grow) {
+		for (; parent != no_parent; parent = nodes[position_of(parent)].parent) {
+			auto &size = nodes[position_of(parent)].size;
+			size = grow ? size + count : size - count;
+		}
+	}
+
+	// Moves the subtree at pos so that it ends up right before target, which is outside of it
+	std::size_t move_subtree(std::size_t pos, std::size_t target) {
+		auto size = nodes[pos].size;
+		auto first = nodes.begin();
+		if (target > pos) {
+			assert(target >= pos + size);
+			std::rotate(first + pos, first + pos + size, first + target);
+			update_positions(pos, target);
+			return target - size;
+		}
+		std::rotate(first + target, first + pos, first + pos + size);
+		update_positions(target, pos + size);
+		return target;
+	}
+
+	void add(entity_id_t id) {
+		if (contains(id)) return;
+		nodes.push_back(node{id, no_parent, 1});
+		positions.emplace(id, nodes.size() - 1);
+	}
+public:
+	bool empty() const {
+		return nodes.empty();
+	}
+
+	void clear() {
+		nodes.clear();
+		positions.clear();
+	}
+
+	const std::vector<node> & get_nodes() const {
+		return nodes;
+	}
+
+	// Position of each node in get_nodes(), in id order
+	const flat_map<entity_id_t, std::size_t> & get_positions() const {
+		return positions;
+	}
+
+	bool contains(entity_id_t id) const {
+		return positions.find(id) != positions.end();
+	}
+
+	entity_id_t parent_of(entity_id_t id) const {
+		auto pos = positions.find(id);
+		return pos == positions.end() ? no_parent : nodes[pos->second].parent;
+	}
+
+	bool is_descendant(entity_id_t id, entity_id_t ancestor) const {
+		for (; id != no_parent; id = parent_of(id)) {
+			if (id == ancestor) return true;
+		}
+		return false;
+	}
+
+	template <typename Func>
+	void for_each_child(entity_id_t id, Func &&func) const {
+		auto pos = positions.find(id);
+		if (pos == positions.end()) return;
+		auto last = pos->second + nodes[pos->second].size;
+		for (auto i = pos->second + 1; i < last; i += nodes[i].size) func(nodes[i].id);
+	}
+
+	// parent must not be child or one of its descendants
+	void set_parent(entity_id_t child, entity_id_t parent) {
+		assert(!is_descendant(parent, child));
+		add(child);
+		add(parent);
+		auto pos = position_of(child);
+		auto &childNode = nodes[pos];
+		if (childNode.parent == parent) return;
+
+		// Becomes the last child of parent. Taken before any sizes change, so that it's past
+		// child's subtree when child is already a descendant of parent.
+		auto parentPos = position_of(parent);
+		auto target = parentPos + nodes[parentPos].size;
+		auto size = childNode.size;
+		resize_ancestors(childNode.parent, size, false);
+		childNode.parent = parent;
+		move_subtree(pos, target);
+		resize_ancestors(parent, size, true);
+	}
+
+	// Turns child into a root, returns false if it didn't have a parent
+	bool clear_parent(entity_id_t child) {
+		auto parent = parent_of(child);
+		if (parent == no_parent) return false;
+		auto pos = position_of(child);
+		resize_ancestors(parent, nodes[pos].size, false);
+		nodes[pos].parent = no_parent;
+		move_subtree(pos, nodes.size());
+		return true;
+	}
+
+	// Removes a single node, its children become roots
+	void erase(entity_id_t id) {
+		auto found = positions.find(id);
+		if (found == positions.end()) return;
+		auto pos = found->second;
+		if (nodes[pos].parent != no_parent) {
+			resize_ancestors(nodes[pos].parent, nodes[pos].size, false);
+			pos = move_subtree(pos, nodes.size());
+		}
+		for (auto i = pos + 1; i < pos + nodes[pos].size; i += nodes[i].size) nodes[i].parent = no_parent;
+		nodes.erase(nodes.begin() + pos);
+		positions.erase(id);
+		update_positions(pos, nodes.size());
+	}
+
+	// Removes the node and all of its descendants, returning their ids parents first
+	std::vector<entity_id_t> erase_subtree(entity_id_t id) {
+		std::vector<entity_id_t> ids;
+		auto found = positions.find(id);
+		if (found == positions.end()) {
+			ids.push_back(id);
+			return ids;
+		}
+		auto pos = found->second, size = nodes[pos].size;
+		resize_ancestors(nodes[pos].parent, size, false);
+		ids.reserve(size);
+		for (auto i = pos; i < pos + size; ++i) ids.push_back(nodes[i].id);
+		positions.erase_if([&](const std::pair<entity_id_t, std::size_t> &entry) {
+			return entry.second >= pos && entry.second < pos + size;
+		});
+		nodes.erase(nodes.begin() + pos, nodes.begin() + pos + size);
+		update_positions(pos, nodes.size());
+		return ids;
+	}
+};
+} // namespace detail
+}
@@ -0,0 +1,267 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+#include "metafunctions.h"
+#include "typelist.h"
+
+namespace entityplus {
+// Specialize with
+//   static void write(std::vector<char> &out, const Event &event);
+//   static Event read(const char *data, std::size_t size);
+// to journal events that aren't trivially copyable. write appends to out, read gets back
+// exactly what was appended.
+template <typename Event>
+struct event_serializer {};
+
+namespace detail {
+template <typename Event, typename = void>
+struct has_event_serializer : std::false_type {};
+
+template <typename Event>
+struct has_event_serializer<Event, meta::void_t<decltype(event_serializer<Event>::write(
+	std::declval<std::vector<char> &>(), std::declval<const Event &>()))>> : std::true_type {};
+
+template <typename Event>
+struct is_journaled : meta::or_<has_event_serializer<Event>, std::is_trivially_copyable<Event>> {};
+
+// Component events only refer to the component
+template <typename Entity, typename Component>
+struct is_journaled<component_added<Entity, Component>> : std::false_type {};
+
+template <typename Entity, typename Component>
+struct is_journaled<component_removed<Entity, Component>> : std::false_type {};
+} // namespace detail
+
+// Records the events of an event manager frame by frame, to be saved and replayed later.
+// Events are copied bytewise or written by their event_serializer, the rest (including component
+// events) are left out. Entity events hold the entity handle as it was, so replaying them is only
+// meaningful within the same process. The event manager must outlive the attachment.
+template <typename... Components, typename... Tags, typename... Events>
+class event_journal<component_list<Components...>, tag_list<Tags...>, Events...> {
+public:
+	using event_manager_t = event_manager<component_list<Components...>, tag_list<Tags...>, Events...>;
+private:
+	using events_t = typename event_manager_t::events_t;
+	using replay_t = void(*)(event_manager_t &, const char *, std::size_t);
+
+	struct record_header {
+		std::uint32_t type, size;
+	};
+
+	static constexpr char magic[4] = {'E', 'P', 'J', '1'};
+
+	template <typename... Ts>
+	static constexpr std::uint32_t count_events(meta::detail::type_holder<meta::typelist<Ts...>>) {
+		return sizeof...(Ts);
+	}
+
+	std::vector<char> data;
+	// Offset of every frame into data
+	std::vector<std::size_t> frames;
+	event_manager_t *manager = nullptr;
+
+	template <typename Event>
+	static void record_event(void *self, const Event &event) {
+		static_cast<event_journal *>(self)->record(event);
+	}
+
+	template <typename Event>
+	void record(const Event &event) {
+		if (frames.empty()) frames.push_back(0);
+		auto headerPos = data.size();
+		data.resize(headerPos + sizeof(record_header));
+		write(event, detail::has_event_serializer<Event>{});
+		record_header header{static_cast<std::uint32_t>(meta::typelist_index_v<Event, events_t>),
+							 static_cast<std::uint32_t>(data.size() - headerPos - sizeof(record_header))};
+		std::memcpy(data.data() + headerPos, &header, sizeof(header));
+	}
+
+	template <typename Event>
+	void write(const Event &event, std::true_type) {
+		event_serializer<Event>::write(data, event);
+	}
+
+	template <typename Event>
+	void write(const Event &event, std::false_type) {
+		auto bytes = reinterpret_cast<const char *>(&event);
+		data.insert(data.end(), bytes, bytes + sizeof(Event));
+	}
+
+	template <typename Event>
+	static void replay_event(event_manager_t &em, const char *bytes, std::size_t size) {
+		replay_event<Event>(em, bytes, size, detail::has_event_serializer<Event>{});
+	}
+
+	template <typename Event>
+	static void replay_event(event_manager_t &em, const char *bytes, std::size_t size, std::true_type) {
+		em.replay(event_serializer<Event>::read(bytes, size));
+	}
+
+	template <typename Event>
+	static void replay_event(event_manager_t &em, const char *bytes, std::size_t size, std::false_type) {
+		(void)size; assert(size == sizeof(Event));
+		typename std::aligned_storage<sizeof(Event), alignof(Event)>::type storage;
+		std::memcpy(&storage, bytes, sizeof(Event));
+		em.replay(*reinterpret_cast<const Event *>(&storage));
+	}
+
+	template <typename Event>
+	static constexpr replay_t replayer(std::true_type) {
+		return &replay_event<Event>;
+	}
+
+	template <typename Event>
+	static constexpr replay_t replayer(std::false_type) {
+		return nullptr;
+	}
+
+	template <typename... Ts>
+	static std::array<replay_t, sizeof...(Ts)> make_replayers(meta::detail::type_holder<meta::typelist<Ts...>>) {
+		return {{replayer<Ts>(detail::is_journaled<Ts>{})...}};
+	}
+
+	template <typename Event>
+	static detail::event_func_t<Event> recorder_for(event_journal *journal, std::true_type) {
+		if (!journal) return {};
+		return {&record_event<Event>, journal};
+	}
+
+	template <typename Event>
+	static detail::event_func_t<Event> recorder_for(event_journal *, std::false_type) {
+		return {};
+	}
+
+	void set_recorders(event_journal *journal) {
+		auto install = [&](auto &channel, std::size_t, auto) {
+			using Event = typename std::decay_t<decltype(channel)>::event_type;
+			channel.recorder = recorder_for<Event>(journal, detail::is_journaled<Event>{});
+		};
+		meta::for_each(manager->channels, install);
+		// The entity manager only builds the entity events that are active
+		meta::for_each(manager->entityEventManager.channels, [&](auto &channel, std::size_t idx, auto type) {
+			install(channel, idx, type);
+			using Event = typename std::decay_t<decltype(channel)>::event_type;
+			manager->entityEventManager.template update_active<Event>();
+		});
+	}
+public:
+	event_journal() = default;
+	event_journal(const event_journal &) = delete;
+	event_journal& operator=(const event_journal &) = delete;
+
+	~event_journal() {
+		detach();
+	}
+
+	// Records every event em broadcasts, enqueues or collects from producers from now on
+	void attach(event_manager_t &em) {
+		detach();
+		manager = &em;
+		set_recorders(this);
+	}
+
+	void detach() {
+		if (!manager) return;
+		set_recorders(nullptr);
+		manager = nullptr;
+	}
+
+	// Events recorded from now on belong to a new frame
+	void begin_frame() {
+		frames.push_back(data.size());
+	}
+
+	std::size_t frame_count() const {
+		return frames.size();
+	}
+
+	std::size_t size_bytes() const {
+		return data.size();
+	}
+
+	void clear() {
+		data.clear();
+		frames.clear();
+	}
+
+	// Broadcasts the events of frames [first, last) through em in the order they were recorded.
+	// em must not be the event manager this journal is attached to.
+	void replay(event_manager_t &em, std::size_t first, std::size_t last) const {
+		assert(&em != manager && "replaying into the recorded event manager");
+		assert(first <= last && last <= frames.size());
+		static const auto replayers = make_replayers(meta::detail::type_holder<events_t>{});
+		if (first == last) return;
+		auto pos = frames[first];
+		auto end = last == frames.size() ? data.size() : frames[last];
+		while (pos < end) {
+			record_header header;
+			std::memcpy(&header, data.data() + pos, sizeof(header));
+			pos += sizeof(header);
+			assert(header.type < replayers.size() && replayers[header.type]);
+			replayers[header.type](em, data.data() + pos, header.size);
+			pos += header.size;
+		}
+	}
+
+	void replay(event_manager_t &em) const {
+		replay(em, 0, frames.size());
+	}
+
+	// Written in native byte order, for loading back on the same platform with the same events
+	void save(std::ostream &out) const {
+		auto write_value = [&](auto value) {
+			out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+		};
+		out.write(magic, sizeof(magic));
+		write_value(count_events(meta::detail::type_holder<events_t>{}));
+		write_value(static_cast<std::uint64_t>(frames.size()));
+		for (auto frame : frames) write_value(static_cast<std::uint64_t>(frame));
+		write_value(static_cast<std::uint64_t>(data.size()));
+		out.write(data.data(), data.size());
+	}
+
+	// Replaces the contents of the journal, returns false and leaves them alone if in doesn't hold
+	// a journal of the same events
+	bool load(std::istream &in) {
+		auto read_value = [&](auto &value) {
+			return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+		};
+		char header[sizeof(magic)];
+		std::uint32_t typeCount;
+		std::uint64_t frameCount, size;
+		if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0 ||
+			!read_value(typeCount) || typeCount != count_events(meta::detail::type_holder<events_t>{}) ||
+			!read_value(frameCount)) return false;
+
+		std::vector<std::size_t> newFrames;
+		for (std::uint64_t i = 0; i < frameCount; ++i) {
+			std::uint64_t frame;
+			if (!read_value(frame)) return false;
+			newFrames.push_back(static_cast<std::size_t>(frame));
+		}
+		if (!read_value(size)) return false;
+		std::vector<char> newData(static_cast<std::size_t>(size));
+		if (!in.read(newData.data(), newData.size())) return false;
+
+		data = std::move(newData);
+		frames = std::move(newFrames);
+		return true;
+	}
+};
+
+template <typename... Components, typename... Tags, typename... Events>
+constexpr char event_journal<component_list<Components...>, tag_list<Tags...>, Events...>::magic[4];
+}
@@ -34,6 +34,14 @@ using and_ = std::integral_constant<bool, T::value && U::value>;
 template <typename T, typename U>
 using or_ = std::integral_constant<bool, T::value || U::value>;
 
+template <typename...>
+struct make_void {
+	using type = void;
+};
+
+template <typename... Ts>
+using void_t = typename make_void<Ts...>::type;
+
 template <typename T>
 const T& as_const(T &t) {
 	return t;
@@ -195,6 +203,29 @@ struct typelist_intersection<typelist<T, Ts...>, typelist<Us...>> {
 template <typename T, typename U>
 using typelist_intersection_t = typename typelist_intersection<T, U>::type;
 
+/* -----------------------
+** typelist_difference
+** -----------------------
+*/
+
+template <typename T, typename U>
+struct typelist_difference;
+
+template <typename... Us>
+struct typelist_difference<typelist<>, typelist<Us...>> {
+	using type = typelist<>;
+};
+
+template <typename T, typename... Ts, typename... Us>
+struct typelist_difference<typelist<T, Ts...>, typelist<Us...>> {
+	using type = std::conditional_t<typelist_has_type_v<T, typelist<Us...>>,
+		typename typelist_difference<typelist<Ts...>, typelist<Us...>>::type,
+		typelist_concat_t<typelist<T>, typename typelist_difference<typelist<Ts...>, typelist<Us...>>::type>>;
+};
+
+template <typename T, typename U>
+using typelist_difference_t = typename typelist_difference<T, U>::type;
+
 /* -----------------------
 ** for_each
 ** -----------------------
@@ -206,8 +237,8 @@ struct type_holder {
 	using type = T;
 };
 
-template <typename... Ts, typename Func, std::size_t... Is>
-inline void for_each_impl(std::tuple<Ts...> &tup, Func &&func, std::index_sequence<Is...>) {
+template <typename Tuple, typename... Ts, typename Func, std::size_t... Is>
+inline void for_each_impl(Tuple &tup, Func &&func, type_holder<std::tuple<Ts...>>, std::index_sequence<Is...>) {
 	(void)tup; (void)func;
 	std::initializer_list<int> _ = {((void)func(std::get<Is>(tup), Is, type_holder<Ts>{}), 0)...};
 }
@@ -215,7 +246,14 @@ inline void for_each_impl(std::tuple<Ts...> &tup, Func &&func, std::index_sequen
 
 template <typename... Ts, typename Func>
 inline void for_each(std::tuple<Ts...> &tup, Func&& func) {
-	detail::for_each_impl(tup, std::forward<Func>(func), std::index_sequence_for<Ts...>{});
+	detail::for_each_impl(tup, std::forward<Func>(func), detail::type_holder<std::tuple<Ts...>>{},
+						  std::index_sequence_for<Ts...>{});
+}
+
+template <typename... Ts, typename Func>
+inline void for_each(const std::tuple<Ts...> &tup, Func&& func) {
+	detail::for_each_impl(tup, std::forward<Func>(func), detail::type_holder<std::tuple<Ts...>>{},
+						  std::index_sequence_for<Ts...>{});
 }
 
 /* -----------------------
@@ -265,10 +303,12 @@ detail::fail_cond_t<Pred, Func> fail_cond(Func&& func) {
 
 template <typename Func, typename... Preds, typename... Funcs>
 decltype(auto) eval_if(Func&& success, detail::fail_cond_t<Preds, Funcs>&&... fcs) {
+	// Named so rt doesn't refer to a temporary that's gone by the time it's called
+	auto successCond = fail_cond<std::false_type>(std::forward<Func>(success));
 	auto &&rt = detail::get_success(
 		detail::tag<1>{},
 		std::move(fcs)...,
-		fail_cond<std::false_type>(std::forward<Func>(success)));
+		std::move(successCond));
 	using pred_type = typename std::decay_t<decltype(rt)>::pred_type;
 	return rt.func(detail::identity<pred_type>{});
 }
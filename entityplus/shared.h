@@ -0,0 +1,194 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <cassert>
+
+#include "soa.h"
+
+namespace entityplus {
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class shared;
+
+namespace detail {
+// Deduplicated, reference counted values. Nodes never move so handles can point straight at them.
+template <typename T, typename Hash, typename KeyEqual>
+class shared_pool {
+public:
+	struct node {
+		T value;
+		std::size_t refs, hash;
+		bool interned;
+		shared_pool *pool;
+	};
+private:
+	std::unordered_map<std::size_t, std::vector<node *>> buckets;
+	std::size_t nodeCount = 0;
+	Hash hasher;
+	KeyEqual equal;
+
+	void unindex(node *n) {
+		auto bucket = buckets.find(n->hash);
+		assert(bucket != buckets.end());
+		auto &nodes = bucket->second;
+		nodes.erase(std::find(nodes.begin(), nodes.end(), n));
+		if (nodes.empty()) buckets.erase(bucket);
+		n->interned = false;
+	}
+public:
+	shared_pool() = default;
+	shared_pool(const shared_pool &) = delete;
+	shared_pool& operator=(const shared_pool &) = delete;
+	~shared_pool() {
+		assert(nodeCount == 0 && "shared components must not outlive their pool");
+	}
+
+	// Number of distinct values alive
+	std::size_t size() const {
+		return nodeCount;
+	}
+
+	template <typename... Args>
+	node * acquire(Args&&... args) {
+		T value(std::forward<Args>(args)...);
+		auto hash = hasher(value);
+		auto &nodes = buckets[hash];
+		for (auto n : nodes) {
+			if (equal(n->value, value)) {
+				++n->refs;
+				return n;
+			}
+		}
+		nodes.push_back(new node{std::move(value), 1, hash, true, this});
+		++nodeCount;
+		return nodes.back();
+	}
+
+	static void add_ref(node *n) {
+		++n->refs;
+	}
+
+	static void release(node *n) {
+		if (--n->refs != 0) return;
+		if (n->interned) n->pool->unindex(n);
+		--n->pool->nodeCount;
+		delete n;
+	}
+
+	// Returns a node only n's owner refers to, copying the value if it is shared.
+	// The node leaves the index since its value is about to change.
+	static node * make_unique(node *n) {
+		if (n->refs == 1) {
+			if (n->interned) n->pool->unindex(n);
+			return n;
+		}
+		--n->refs;
+		++n->pool->nodeCount;
+		return new node{n->value, 1, 0, false, n->pool};
+	}
+};
+
+struct no_shared_pool {};
+
+template <typename Component>
+struct shared_traits : std::false_type {
+	using pool_type = no_shared_pool;
+};
+
+template <typename T, typename Hash, typename KeyEqual>
+struct shared_traits<shared<T, Hash, KeyEqual>> : std::true_type {
+	using pool_type = shared_pool<T, Hash, KeyEqual>;
+};
+
+// Shared components can also be built from the arguments of the value they hold
+template <typename Component, typename... Args>
+struct is_component_constructible : std::is_constructible<Component, Args...> {};
+
+template <typename T, typename Hash, typename KeyEqual, typename... Args>
+struct is_component_constructible<shared<T, Hash, KeyEqual>, Args...>
+	: std::integral_constant<bool, std::is_constructible<shared<T, Hash, KeyEqual>, Args...>::value ||
+		std::is_constructible<T, Args...>::value> {};
+
+// What for_each hands out for a component, shared ones are only readable
+template <typename Component>
+struct component_access {
+	using reference = typename component_storage<Component>::reference;
+};
+
+template <typename T, typename Hash, typename KeyEqual>
+struct component_access<shared<T, Hash, KeyEqual>> {
+	using reference = const T &;
+};
+
+template <typename Component>
+Component & access_component(Component &comp) {
+	return comp;
+}
+
+template <typename T, typename Hash, typename KeyEqual>
+const T & access_component(shared<T, Hash, KeyEqual> &comp) {
+	return *comp;
+}
+} // namespace detail
+
+// Handle to a value shared by every entity holding an equal one
+template <typename T, typename Hash, typename KeyEqual>
+class shared {
+public:
+	using value_type = T;
+	using pool_type = detail::shared_pool<T, Hash, KeyEqual>;
+private:
+	typename pool_type::node *node = nullptr;
+public:
+	template <typename... Args>
+	explicit shared(pool_type &pool, Args&&... args)
+		: node(pool.acquire(std::forward<Args>(args)...)) {}
+
+	shared(const shared &other) noexcept : node(other.node) {
+		if (node) pool_type::add_ref(node);
+	}
+
+	shared(shared &&other) noexcept : node(other.node) {
+		other.node = nullptr;
+	}
+
+	shared& operator=(shared other) noexcept {
+		std::swap(node, other.node);
+		return *this;
+	}
+
+	~shared() {
+		if (node) pool_type::release(node);
+	}
+
+	const T& operator*() const {
+		assert(node);
+		return node->value;
+	}
+
+	const T* operator->() const {
+		assert(node);
+		return &node->value;
+	}
+
+	// Copy on write, detaches this handle from the others before handing out the value
+	T& modify() {
+		assert(node);
+		node = pool_type::make_unique(node);
+		return node->value;
+	}
+
+	std::size_t use_count() const {
+		return node ? node->refs : 0;
+	}
+};
+}
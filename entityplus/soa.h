@@ -0,0 +1,605 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <new>
+#include <tuple>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+#include <cassert>
+
+#include "container.h"
+#include "storage.h"
+
+namespace entityplus {
+template <typename T, typename F, F T::*Member>
+struct soa_field {
+	using component_type = T;
+	using type = F;
+	static_assert(!std::is_same<std::remove_cv_t<F>, bool>::value,
+				  "soa_field can't be a bool, std::vector<bool> doesn't store bools");
+
+	constexpr static F T::* member() {
+		return Member;
+	}
+};
+
+#define ENTITYPLUS_SOA_FIELD(Type, name) ::entityplus::soa_field<Type, decltype(Type::name), &Type::name>
+
+// The fields should make up all of T, T is rebuilt as T{fields...}
+template <typename T, typename... Fields>
+struct soa_layout : std::true_type {
+	static_assert(sizeof...(Fields) > 0, "soa_layout needs at least one field");
+};
+
+// Specialize as soa_layout<Component, Fields...> to store every field of Component in its own array
+template <typename Component>
+struct soa_traits : std::false_type {};
+
+namespace detail {
+// Over-aligns the allocation so field arrays line up with cache lines and vector registers
+template <typename T, std::size_t Align>
+struct aligned_allocator {
+	using value_type = T;
+	template <typename U>
+	struct rebind {
+		using other = aligned_allocator<U, Align>;
+	};
+
+	aligned_allocator() = default;
+	template <typename U>
+	aligned_allocator(const aligned_allocator<U, Align> &) noexcept {}
+
+	T * allocate(std::size_t n) {
+		auto raw = ::operator new(n * sizeof(T) + Align + sizeof(void *));
+		auto addr = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *) + Align - 1) & ~std::uintptr_t(Align - 1);
+		reinterpret_cast<void **>(addr)[-1] = raw;
+		return reinterpret_cast<T *>(addr);
+	}
+
+	void deallocate(T *ptr, std::size_t) noexcept {
+		::operator delete(reinterpret_cast<void **>(ptr)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const aligned_allocator<U, Align> &) const noexcept {
+		return true;
+	}
+	template <typename U>
+	bool operator!=(const aligned_allocator<U, Align> &) const noexcept {
+		return false;
+	}
+};
+
+constexpr std::size_t soa_alignment = 64;
+
+template <typename F>
+using soa_column = std::vector<F, aligned_allocator<F, soa_alignment>>;
+
+template <typename Field, typename F, typename T, typename Column>
+void find_soa_field(F *&found, F T::*member, Column &column, std::size_t idx, std::true_type) {
+	if (Field::member() == member) found = column.data() + idx;
+}
+
+template <typename Field, typename F, typename T, typename Column>
+void find_soa_field(F *&, F T::*, Column &, std::size_t, std::false_type) {}
+
+template <typename F, typename T, typename... Fields, typename Columns, std::size_t... Is>
+F * find_soa_field(F T::*member, Columns &columns, std::size_t idx, std::index_sequence<Is...>) {
+	F *found = nullptr;
+	std::initializer_list<int> _ = {((void)find_soa_field<Fields>(found, member, std::get<Is>(columns), idx,
+																   std::is_same<typename Fields::type, F>{}), 0)...};
+	(void)_;
+	assert(found && "member is not a field of the soa_layout");
+	return found;
+}
+} // namespace detail
+
+// Contiguous run of one field
+template <typename F>
+class field_span {
+	F *first;
+	std::size_t count;
+public:
+	field_span(F *first, std::size_t count) : first(first), count(count) {}
+
+	F * begin() const { return first; }
+	F * end() const { return first + count; }
+	F * data() const { return first; }
+	std::size_t size() const { return count; }
+	F & operator[](std::size_t idx) const {
+		assert(idx < count);
+		return first[idx];
+	}
+};
+
+// Stands in for T& when T is stored as a struct of arrays
+template <typename T, typename... Fields>
+class soa_reference {
+public:
+	using columns_type = std::tuple<detail::soa_column<typename Fields::type>...>;
+private:
+	columns_type *columns;
+	std::size_t idx;
+
+	template <std::size_t... Is>
+	T load(std::index_sequence<Is...>) const {
+		return T{std::get<Is>(*columns)[idx]...};
+	}
+
+	template <std::size_t... Is>
+	void store(const T &value, std::index_sequence<Is...>) const {
+		std::initializer_list<int> _ = {((void)(std::get<Is>(*columns)[idx] = value.*Fields::member()), 0)...};
+		(void)_;
+	}
+public:
+	soa_reference(columns_type &columns, std::size_t idx) : columns(&columns), idx(idx) {}
+	soa_reference(const soa_reference &) = default;
+
+	operator T() const {
+		return load(std::index_sequence_for<Fields...>{});
+	}
+
+	const soa_reference & operator=(const T &value) const {
+		store(value, std::index_sequence_for<Fields...>{});
+		return *this;
+	}
+	const soa_reference & operator=(const soa_reference &other) const {
+		return *this = T(other);
+	}
+
+	// ref[&T::x] is the x of the referred to value
+	template <typename F>
+	F & operator[](F T::*member) const {
+		return *detail::find_soa_field<F, T, Fields...>(member, *columns, idx, std::index_sequence_for<Fields...>{});
+	}
+};
+
+// A run of consecutively stored values, each field as its own span
+template <typename T, typename... Fields>
+class soa_chunk {
+	using columns_type = typename soa_reference<T, Fields...>::columns_type;
+	columns_type *columns;
+	std::size_t first, count;
+public:
+	soa_chunk(columns_type &columns, std::size_t first, std::size_t count)
+		: columns(&columns), first(first), count(count) {}
+
+	std::size_t size() const {
+		return count;
+	}
+
+	// chunk[&T::x] is every x in the chunk
+	template <typename F>
+	field_span<F> operator[](F T::*member) const {
+		return{detail::find_soa_field<F, T, Fields...>(member, *columns, first, std::index_sequence_for<Fields...>{}),
+			count};
+	}
+
+	soa_reference<T, Fields...> at(std::size_t idx) const {
+		assert(idx < count);
+		return{*columns, first + idx};
+	}
+};
+
+namespace detail {
+template <typename Key, typename Value>
+struct soa_entry {
+	const Key &first;
+	Value second;
+};
+
+template <typename Map, typename Value>
+class soa_iterator {
+	template <typename, typename>
+	friend class soa_iterator;
+
+	Map *map = nullptr;
+	std::size_t pos = 0;
+
+	using entry = soa_entry<typename Map::key_type, Value>;
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = entry;
+	using reference = entry;
+	using difference_type = std::ptrdiff_t;
+	struct pointer {
+		entry value;
+		entry * operator->() {
+			return &value;
+		}
+	};
+
+	soa_iterator() = default;
+	soa_iterator(Map *map, std::size_t pos) : map(map), pos(pos) {}
+	template <typename OtherMap, typename OtherValue,
+		typename = std::enable_if_t<std::is_convertible<OtherMap *, Map *>::value>>
+	soa_iterator(const soa_iterator<OtherMap, OtherValue> &other) : map(other.map), pos(other.pos) {}
+
+	reference operator*() const {
+		return{map->key_at(pos), map->value_at(pos)};
+	}
+	pointer operator->() const {
+		return{**this};
+	}
+	reference operator[](difference_type n) const {
+		return *(*this + n);
+	}
+
+	soa_iterator & operator++() { ++pos; return *this; }
+	soa_iterator operator++(int) { auto ret = *this; ++pos; return ret; }
+	soa_iterator & operator--() { --pos; return *this; }
+	soa_iterator operator--(int) { auto ret = *this; --pos; return ret; }
+	soa_iterator & operator+=(difference_type n) { pos += n; return *this; }
+	soa_iterator & operator-=(difference_type n) { pos -= n; return *this; }
+	soa_iterator operator+(difference_type n) const { return{map, pos + n}; }
+	soa_iterator operator-(difference_type n) const { return{map, pos - n}; }
+	friend soa_iterator operator+(difference_type n, const soa_iterator &it) { return it + n; }
+
+	template <typename OtherMap, typename OtherValue>
+	difference_type operator-(const soa_iterator<OtherMap, OtherValue> &other) const {
+		return difference_type(pos) - difference_type(other.pos);
+	}
+	template <typename OtherMap, typename OtherValue>
+	bool operator==(const soa_iterator<OtherMap, OtherValue> &other) const {
+		return pos == other.pos;
+	}
+	template <typename OtherMap, typename OtherValue>
+	bool operator!=(const soa_iterator<OtherMap, OtherValue> &other) const {
+		return pos != other.pos;
+	}
+	template <typename OtherMap, typename OtherValue>
+	bool operator<(const soa_iterator<OtherMap, OtherValue> &other) const {
+		return pos < other.pos;
+	}
+};
+} // namespace detail
+
+// Same interface as dense_map, but each field of T lives in its own aligned array.
+// Iterating yields (key, soa_reference) pairs, or (key, T) copies when const.
+template <typename Key, typename T, typename... Fields>
+class soa_map {
+public:
+	using key_type = Key;
+	using mapped_type = T;
+	using reference = soa_reference<T, Fields...>;
+	using const_reference = T;
+	using columns_type = typename reference::columns_type;
+	using chunk_type = soa_chunk<T, Fields...>;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using iterator = detail::soa_iterator<soa_map, reference>;
+	using const_iterator = detail::soa_iterator<const soa_map, const_reference>;
+	using index_type = flat_map<Key, size_type>;
+private:
+	template <typename, typename>
+	friend class detail::soa_iterator;
+
+	std::vector<Key> keys;
+	columns_type columns;
+	index_type index;
+	bool customOrder = false;
+
+	const Key & key_at(size_type idx) const {
+		return keys[idx];
+	}
+	reference value_at(size_type idx) {
+		return{columns, idx};
+	}
+	const_reference value_at(size_type idx) const {
+		return reference{const_cast<columns_type &>(columns), idx};
+	}
+
+	template <std::size_t... Is>
+	void push_value(const T &value, std::index_sequence<Is...>) {
+		std::initializer_list<int> _ = {((void)std::get<Is>(columns).push_back(value.*Fields::member()), 0)...};
+		(void)_;
+	}
+
+	template <typename Func, std::size_t... Is>
+	void for_each_column(Func &&func, std::index_sequence<Is...>) {
+		std::initializer_list<int> _ = {((void)func(std::get<Is>(columns)), 0)...};
+		(void)_;
+	}
+
+	template <typename Func>
+	void for_each_column(Func &&func) {
+		for_each_column(func, std::index_sequence_for<Fields...>{});
+	}
+
+	template <typename Func, std::size_t... Is>
+	void for_each_column(Func &&func, std::index_sequence<Is...>) const {
+		std::initializer_list<int> _ = {((void)func(std::get<Is>(columns)), 0)...};
+		(void)_;
+	}
+
+	template <typename Func>
+	void for_each_column(Func &&func) const {
+		for_each_column(func, std::index_sequence_for<Fields...>{});
+	}
+
+	template <typename Tuple, std::size_t... Is>
+	static T construct(Tuple &&args, std::index_sequence<Is...>) {
+		(void)args;
+		return T(std::get<Is>(std::move(args))...);
+	}
+
+	// Moves the last value into idx, the index entry of the value that was there is left alone
+	void fill_hole(size_type idx) {
+		auto last = keys.size() - 1;
+		if (idx != last) {
+			keys[idx] = keys[last];
+			for_each_column([&](auto &column) {
+				column[idx] = std::move(column[last]);
+			});
+			index.find(keys[idx])->second = idx;
+		}
+		keys.pop_back();
+		for_each_column([](auto &column) {
+			column.pop_back();
+		});
+	}
+
+	void swap_values(size_type lhs, size_type rhs) {
+		using std::swap;
+		swap(keys[lhs], keys[rhs]);
+		for_each_column([&](auto &column) {
+			swap(column[lhs], column[rhs]);
+		});
+	}
+
+	// Reorders values so that the i-th value becomes the old perm[i]-th value
+	void apply_permutation(std::vector<size_type> &perm) {
+		std::vector<size_type> newPos(perm.size());
+		for (size_type i = 0; i < perm.size(); ++i) newPos[perm[i]] = i;
+		for (auto &entry : index) entry.second = newPos[entry.second];
+
+		for (size_type i = 0; i < perm.size(); ++i) {
+			auto curr = i;
+			while (perm[curr] != i) {
+				swap_values(curr, perm[curr]);
+				auto next = perm[curr];
+				perm[curr] = curr;
+				curr = next;
+			}
+			perm[curr] = curr;
+		}
+	}
+
+	// Compares rebuilt values, so sorting costs a T construction per comparison
+	template <typename Cmp>
+	auto value_comp(Cmp &cmp) {
+		return [&](size_type lhs, size_type rhs) {
+			const T lhsValue = value_at(lhs), rhsValue = value_at(rhs);
+			return cmp(lhsValue, rhsValue);
+		};
+	}
+public:
+	iterator begin() { return{this, 0}; }
+	const_iterator begin() const { return{this, 0}; }
+	const_iterator cbegin() const { return{this, 0}; }
+	iterator end() { return{this, keys.size()}; }
+	const_iterator end() const { return{this, keys.size()}; }
+	const_iterator cend() const { return{this, keys.size()}; }
+
+	bool empty() const { return keys.empty(); }
+	size_type size() const { return keys.size(); }
+	size_type capacity() const { return keys.capacity(); }
+
+	void reserve(size_type count) {
+		keys.reserve(count);
+		for_each_column([&](auto &column) { column.reserve(count); });
+		index.reserve(count);
+	}
+
+	void shrink_to_fit() {
+		keys.shrink_to_fit();
+		for_each_column([](auto &column) { column.shrink_to_fit(); });
+		index.shrink_to_fit();
+	}
+
+	// Keeps the memory for reuse
+	void clear() {
+		keys.clear();
+		for_each_column([](auto &column) { column.clear(); });
+		index.clear();
+		customOrder = false;
+	}
+
+	container_stats memory_stats() const {
+		auto stats = detail::vector_stats(keys);
+		for_each_column([&](const auto &column) { stats.add_memory(detail::vector_stats(column)); });
+		stats.add_memory(index.memory_stats());
+		return stats;
+	}
+
+	const index_type & get_index() const {
+		return index;
+	}
+
+	bool has_custom_order() const {
+		return customOrder;
+	}
+
+	// Values [first, first + count) in storage order
+	chunk_type get_chunk(size_type first, size_type count) {
+		assert(first + count <= size());
+		return{columns, first, count};
+	}
+
+	template <typename... KeyArgs, typename... Args>
+	std::pair<iterator, bool> emplace(std::piecewise_construct_t, std::tuple<KeyArgs...> keyArgs,
+									  std::tuple<Args...> args) {
+		Key key(std::get<0>(keyArgs));
+		auto idx = index.emplace(key, keys.size());
+		if (!idx.second) return{begin() + idx.first->second, false};
+		push_value(construct(std::move(args), std::index_sequence_for<Args...>{}), std::index_sequence_for<Fields...>{});
+		keys.push_back(key);
+		return{end() - 1, true};
+	}
+
+	// Same as emplacing value under each of keys, which must be sorted and larger than every
+	// stored key, but without searching
+	size_type insert_sorted_keys(const std::vector<key_type> &newKeys, const T &value) {
+		detail::reserve_more(keys, newKeys.size());
+		for_each_column([&](auto &column) { detail::reserve_more(column, newKeys.size()); });
+		detail::reserve_more(index, newKeys.size());
+		for (const auto &key : newKeys) {
+			index.emplace_back(key, keys.size());
+			push_value(value, std::index_sequence_for<Fields...>{});
+			keys.push_back(key);
+		}
+		return newKeys.size();
+	}
+
+	iterator find(const key_type &key) {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+	const_iterator find(const key_type &key) const {
+		auto idx = index.find(key);
+		if (idx == index.end()) return end();
+		return begin() + idx->second;
+	}
+
+	// Fills the hole with the last value, so the order of the remaining values changes
+	iterator erase(const_iterator pos) {
+		auto idx = static_cast<size_type>(pos - cbegin());
+		index.erase(keys[idx]);
+		fill_hole(idx);
+		return begin() + idx;
+	}
+
+	// Same as erasing each of keys, which must be sorted, but the index is only compacted once.
+	// Keys that aren't in the map are skipped.
+	size_type erase_sorted_keys(const std::vector<key_type> &keys) {
+		size_type removed = 0;
+		for (const auto &key : keys) {
+			auto idx = index.find(key);
+			if (idx == index.end()) continue;
+			fill_hole(idx->second);
+			++removed;
+		}
+		if (removed) detail::erase_index_keys(index, keys);
+		return removed;
+	}
+	size_type erase(const key_type &key) {
+		auto itr = find(key);
+		if (itr == end()) return 0;
+		erase(itr);
+		return 1;
+	}
+
+	template <typename Cmp>
+	void sort(Cmp &&cmp) {
+		std::vector<size_type> perm(keys.size());
+		std::iota(perm.begin(), perm.end(), size_type(0));
+		std::sort(perm.begin(), perm.end(), value_comp(cmp));
+		apply_permutation(perm);
+		customOrder = true;
+	}
+
+	template <typename Cmp>
+	void insertion_sort(Cmp &&cmp) {
+		std::vector<size_type> perm(keys.size());
+		std::iota(perm.begin(), perm.end(), size_type(0));
+		auto comp = value_comp(cmp);
+		for (size_type i = 1; i < perm.size(); ++i) {
+			auto curr = perm[i];
+			auto j = i;
+			for (; j > 0 && comp(curr, perm[j - 1]); --j) perm[j] = perm[j - 1];
+			perm[j] = curr;
+		}
+		apply_permutation(perm);
+		customOrder = true;
+	}
+
+	// Puts the keys shared with other first, in the order of other
+	template <typename Other>
+	void arrange_like(const Other &other) {
+		std::vector<size_type> perm;
+		perm.reserve(keys.size());
+		std::vector<bool> taken(keys.size());
+		for (const auto &val : other) {
+			auto idx = index.find(val.first);
+			if (idx == index.end()) continue;
+			perm.push_back(idx->second);
+			taken[idx->second] = true;
+		}
+		for (size_type i = 0; i < keys.size(); ++i) {
+			if (!taken[i]) perm.push_back(i);
+		}
+		apply_permutation(perm);
+		customOrder = true;
+	}
+};
+
+namespace detail {
+template <typename Key, typename T, typename... Fields>
+soa_map<Key, T, Fields...> soa_map_for(const soa_layout<T, Fields...> &);
+
+// Picks where and how a component is stored
+template <typename Component, bool = soa_traits<Component>::value>
+struct component_storage {
+	template <typename Key>
+	using container_type = typename component_storage_traits<Component>::template container_type<Key, Component>;
+	using reference = Component &;
+	using const_reference = const Component &;
+};
+
+template <typename Component>
+struct component_storage<Component, true> {
+	template <typename Key>
+	using container_type = decltype(soa_map_for<Key>(soa_traits<Component>{}));
+	using reference = typename container_type<std::size_t>::reference;
+	using const_reference = typename container_type<std::size_t>::const_reference;
+};
+
+template <typename Component>
+using component_reference_t = typename component_storage<Component>::reference;
+
+template <typename Component>
+using component_const_reference_t = typename component_storage<Component>::const_reference;
+
+template <typename T, typename... Fields>
+soa_reference<T, Fields...> access_component(soa_reference<T, Fields...> &ref) {
+	return ref;
+}
+
+// Events hand out a Component &, proxies are turned into a copy first
+template <typename Component, typename Func>
+void with_component_value(Component &comp, Func &&func) {
+	func(comp);
+}
+
+template <typename T, typename... Fields, typename Func>
+void with_component_value(soa_reference<T, Fields...> &ref, Func &&func) {
+	T value = ref;
+	func(value);
+}
+
+// Same for a batch of events, which needs every value at once. The copies go into copies, which
+// gets room for count of them so that none move.
+template <typename Component>
+Component & stable_component_value(Component &comp, std::vector<Component> &, std::size_t) {
+	return comp;
+}
+
+template <typename T, typename... Fields>
+T & stable_component_value(soa_reference<T, Fields...> &ref, std::vector<T> &copies, std::size_t count) {
+	if (copies.empty()) copies.reserve(count);
+	assert(copies.size() < copies.capacity());
+	copies.push_back(ref);
+	return copies.back();
+}
+} // namespace detail
+}
@@ -0,0 +1,248 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <cassert>
+
+#include "container.h"
+#include "typelist.h"
+
+namespace entityplus {
+// 2D users can leave the last coordinate at 0
+using spatial_point = std::array<float, 3>;
+
+namespace detail {
+inline float distance_sq(const spatial_point &lhs, const spatial_point &rhs) {
+	float dx = lhs[0] - rhs[0], dy = lhs[1] - rhs[1], dz = lhs[2] - rhs[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Uniform grid hashing entity ids by cell. Positions are cached next to the ids
+// so queries never touch component storage.
+class spatial_grid {
+public:
+	using cell_coord_t = std::array<std::int64_t, 3>;
+	struct entry {
+		entity_id_t id;
+		spatial_point pos;
+	};
+private:
+	using cell_key_t = std::uint64_t;
+	// Keys wrap every 2^21 cells per axis, which only adds candidates that the
+	// distance check filters out again
+	constexpr static std::int64_t KeyBits = 21;
+	constexpr static std::int64_t KeyMask = (std::int64_t(1) << KeyBits) - 1;
+
+	float cellSize = 1, invCellSize = 1;
+	std::unordered_map<cell_key_t, std::vector<entry>> cells;
+	flat_map<entity_id_t, spatial_point> positions;
+	cell_coord_t minCell{}, maxCell{};
+
+	static cell_key_t make_key(const cell_coord_t &c) {
+		return (cell_key_t(c[0] & KeyMask) << (2 * KeyBits)) |
+			(cell_key_t(c[1] & KeyMask) << KeyBits) |
+			cell_key_t(c[2] & KeyMask);
+	}
+
+	void add_to_cell(entity_id_t id, const spatial_point &pos) {
+		auto cell = cell_of(pos);
+		if (positions.size() == 1) {
+			minCell = maxCell = cell;
+		}
+		else {
+			for (int i = 0; i < 3; ++i) {
+				minCell[i] = std::min(minCell[i], cell[i]);
+				maxCell[i] = std::max(maxCell[i], cell[i]);
+			}
+		}
+		cells[make_key(cell)].push_back(entry{id, pos});
+	}
+
+	void remove_from_cell(entity_id_t id, const spatial_point &pos) {
+		auto cell = cells.find(make_key(cell_of(pos)));
+		assert(cell != cells.end());
+		auto &bucket = cell->second;
+		auto ent = std::find_if(bucket.begin(), bucket.end(), [id](const entry &e) {
+			return e.id == id;
+		});
+		assert(ent != bucket.end());
+		*ent = bucket.back();
+		bucket.pop_back();
+		if (bucket.empty()) cells.erase(cell);
+	}
+
+	template <typename Func>
+	void for_each_entry(Func &&func) const {
+		for (const auto &cell : cells)
+			for (const auto &ent : cell.second) func(ent);
+	}
+
+	// Visits every cell in the box [lo, hi], falling back to a full scan when the
+	// box has more cells than are occupied
+	template <typename Func>
+	void for_each_in_box(const cell_coord_t &lo, const cell_coord_t &hi, Func &&func) const {
+		double boxCells = 1;
+		for (int i = 0; i < 3; ++i) {
+			boxCells *= double(hi[i] - lo[i] + 1);
+			if (hi[i] - lo[i] >= KeyMask) boxCells = std::numeric_limits<double>::infinity();
+		}
+		if (boxCells > double(cells.size())) {
+			for_each_entry(func);
+			return;
+		}
+		for (auto x = lo[0]; x <= hi[0]; ++x)
+			for (auto y = lo[1]; y <= hi[1]; ++y)
+				for (auto z = lo[2]; z <= hi[2]; ++z) {
+					auto cell = cells.find(make_key({x, y, z}));
+					if (cell == cells.end()) continue;
+					for (const auto &ent : cell->second) func(ent);
+				}
+	}
+
+	// Visits the cells at exactly chebyshev distance ring from center
+	template <typename Func>
+	void for_each_in_ring(const cell_coord_t &center, std::int64_t ring, Func &&func) const {
+		for (auto x = center[0] - ring; x <= center[0] + ring; ++x)
+			for (auto y = center[1] - ring; y <= center[1] + ring; ++y) {
+				bool onFace = x == center[0] - ring || x == center[0] + ring ||
+					y == center[1] - ring || y == center[1] + ring;
+				auto step = onFace || ring == 0 ? 1 : 2 * ring;
+				for (auto z = center[2] - ring; z <= center[2] + ring; z += step) {
+					auto cell = cells.find(make_key({x, y, z}));
+					if (cell == cells.end()) continue;
+					for (const auto &ent : cell->second) func(ent);
+				}
+			}
+	}
+public:
+	spatial_grid() = default;
+	explicit spatial_grid(float cellSize) : cellSize(cellSize), invCellSize(1 / cellSize) {
+		assert(cellSize > 0);
+	}
+
+	std::size_t size() const {
+		return positions.size();
+	}
+
+	float get_cell_size() const {
+		return cellSize;
+	}
+
+	cell_coord_t cell_of(const spatial_point &pos) const {
+		return{std::int64_t(std::floor(pos[0] * invCellSize)),
+			std::int64_t(std::floor(pos[1] * invCellSize)),
+			std::int64_t(std::floor(pos[2] * invCellSize))};
+	}
+
+	void insert(entity_id_t id, const spatial_point &pos) {
+		auto emp = positions.emplace(id, pos);
+		(void)emp; assert(emp.second);
+		add_to_cell(id, pos);
+	}
+
+	bool erase(entity_id_t id) {
+		auto pos = positions.find(id);
+		if (pos == positions.end()) return false;
+		remove_from_cell(id, pos->second);
+		positions.erase(pos);
+		return true;
+	}
+
+	// Moves the id to its new cell only if it crossed a cell boundary
+	void update(entity_id_t id, const spatial_point &pos) {
+		auto old = positions.find(id);
+		assert(old != positions.end());
+		if (cell_of(old->second) == cell_of(pos)) {
+			auto &bucket = cells.find(make_key(cell_of(pos)))->second;
+			std::find_if(bucket.begin(), bucket.end(), [id](const entry &e) {
+				return e.id == id;
+			})->pos = pos;
+		}
+		else {
+			remove_from_cell(id, old->second);
+			add_to_cell(id, pos);
+		}
+		old->second = pos;
+	}
+
+	void clear() {
+		cells.clear();
+		positions = {};
+	}
+
+	// Calls func(id, distanceSq) for every id within radius of center
+	template <typename Func>
+	void for_each_within(const spatial_point &center, float radius, Func &&func) const {
+		if (positions.empty()) return;
+		auto lo = cell_of({center[0] - radius, center[1] - radius, center[2] - radius});
+		auto hi = cell_of({center[0] + radius, center[1] + radius, center[2] + radius});
+		for (int i = 0; i < 3; ++i) {
+			lo[i] = std::max(lo[i], minCell[i]);
+			hi[i] = std::min(hi[i], maxCell[i]);
+			if (lo[i] > hi[i]) return;
+		}
+		auto radiusSq = radius * radius;
+		for_each_in_box(lo, hi, [&](const entry &ent) {
+			auto distSq = distance_sq(ent.pos, center);
+			if (distSq <= radiusSq) func(ent.id, distSq);
+		});
+	}
+
+	// Fills out with up to k (distanceSq, id) pairs, closest first
+	void nearest(const spatial_point &center, std::size_t k,
+				 std::vector<std::pair<float, entity_id_t>> &out) const {
+		out.clear();
+		if (k == 0 || positions.empty()) return;
+		auto heapPush = [&](const entry &ent) {
+			auto cand = std::make_pair(distance_sq(ent.pos, center), ent.id);
+			if (out.size() < k) {
+				out.push_back(cand);
+				std::push_heap(out.begin(), out.end());
+			}
+			else if (cand < out.front()) {
+				std::pop_heap(out.begin(), out.end());
+				out.back() = cand;
+				std::push_heap(out.begin(), out.end());
+			}
+		};
+
+		auto centerCell = cell_of(center);
+		std::int64_t maxRing = 0;
+		for (int i = 0; i < 3; ++i) {
+			maxRing = std::max({maxRing, centerCell[i] - minCell[i], maxCell[i] - centerCell[i]});
+		}
+		for (std::int64_t ring = 0; ring <= maxRing; ++ring) {
+			double side = double(2 * ring + 1), inner = double(2 * ring - 1);
+			if (ring >= KeyMask / 2 || side * side * side - inner * inner * inner > double(cells.size())) {
+				// Sparse data, the shells are mostly empty
+				out.clear();
+				for_each_entry(heapPush);
+				break;
+			}
+			for_each_in_ring(centerCell, ring, heapPush);
+			// Anything beyond this ring is at least ring cells away
+			auto reach = float(ring) * cellSize;
+			if (out.size() == k && reach * reach >= out.front().first) break;
+		}
+		std::sort_heap(out.begin(), out.end());
+	}
+};
+
+template <typename Component>
+struct spatial_index {
+	std::function<spatial_point(const Component &)> extractor;
+	spatial_grid grid;
+};
+} // namespace detail
+}
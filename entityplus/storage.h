@@ -0,0 +1,165 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <unordered_map>
+
+#include "metafunctions.h"
+#include "container.h"
+
+namespace entityplus {
+// Contiguous values in an order sort() can change, looked up through a key ordered index
+struct dense_storage {
+	template <typename Key, typename T>
+	using container_type = dense_map<Key, T>;
+};
+
+// Values kept in key order, adding and removing shifts the ones after them
+struct sorted_storage {
+	template <typename Key, typename T>
+	using container_type = flat_map<Key, T>;
+};
+
+// Lookups index straight into an array as large as the largest entity id
+struct sparse_storage {
+	template <typename Key, typename T>
+	using container_type = sparse_map<Key, T>;
+};
+
+// Values are never moved when the storage grows
+template <std::size_t PageSize = 64>
+struct paged_storage {
+	template <typename Key, typename T>
+	using container_type = paged_map<Key, T, PageSize>;
+};
+
+struct hash_storage {
+	template <typename Key, typename T>
+	using container_type = std::unordered_map<Key, T>;
+};
+
+// Specialize to pick how Component is stored, e.g. deriving from paged_storage<16>.
+// soa_traits takes precedence over this.
+template <typename Component>
+struct component_storage_traits : dense_storage {};
+
+namespace detail {
+// Containers with a key ordered get_index() are walked by for_each instead of searched
+template <typename Container, typename = void>
+struct has_key_index : std::false_type {};
+
+template <typename Container>
+struct has_key_index<Container, meta::void_t<decltype(std::declval<const Container &>().get_index())>>
+	: std::true_type {};
+
+// Containers that sort() can reorder
+template <typename Container, typename = void>
+struct is_sortable_storage : std::false_type {};
+
+template <typename Container>
+struct is_sortable_storage<Container, meta::void_t<decltype(std::declval<const Container &>().has_custom_order())>>
+	: std::true_type {};
+
+template <typename Container>
+bool has_custom_order(const Container &container, std::true_type) {
+	return container.has_custom_order();
+}
+
+template <typename Container>
+bool has_custom_order(const Container &, std::false_type) {
+	return false;
+}
+
+template <typename Container>
+bool has_custom_order(const Container &container) {
+	return has_custom_order(container, is_sortable_storage<Container>{});
+}
+
+// Containers that erase a batch of keys at once
+template <typename Container, typename = void>
+struct has_bulk_erase : std::false_type {};
+
+template <typename Container>
+struct has_bulk_erase<Container, meta::void_t<decltype(std::declval<Container &>().erase_sorted_keys(
+	std::declval<const std::vector<typename Container::key_type> &>()))>>
+	: std::true_type {};
+
+template <typename Container, typename Key>
+void erase_sorted_keys(Container &container, const std::vector<Key> &keys, std::true_type) {
+	container.erase_sorted_keys(keys);
+}
+
+template <typename Container, typename Key>
+void erase_sorted_keys(Container &container, const std::vector<Key> &keys, std::false_type) {
+	for (const auto &key : keys) container.erase(key);
+}
+
+// keys must be sorted
+template <typename Container, typename Key>
+void erase_sorted_keys(Container &container, const std::vector<Key> &keys) {
+	erase_sorted_keys(container, keys, has_bulk_erase<Container>{});
+}
+
+// Containers that append a batch of keys sharing a value at once
+template <typename Container, typename = void>
+struct has_bulk_insert : std::false_type {};
+
+template <typename Container>
+struct has_bulk_insert<Container, meta::void_t<decltype(std::declval<Container &>().insert_sorted_keys(
+	std::declval<const std::vector<typename Container::key_type> &>(),
+	std::declval<const typename Container::mapped_type &>()))>>
+	: std::true_type {};
+
+template <typename Container, typename Key, typename T>
+void insert_sorted_keys(Container &container, const std::vector<Key> &keys, const T &value, std::true_type) {
+	container.insert_sorted_keys(keys, value);
+}
+
+template <typename Container, typename Key, typename T>
+void insert_sorted_keys(Container &container, const std::vector<Key> &keys, const T &value, std::false_type) {
+	for (const auto &key : keys) container.emplace(key, value);
+}
+
+// keys must be sorted and larger than every key in container
+template <typename Container, typename Key, typename T>
+void insert_sorted_keys(Container &container, const std::vector<Key> &keys, const T &value) {
+	insert_sorted_keys(container, keys, value, has_bulk_insert<Container>{});
+}
+
+template <typename Container>
+void shrink_storage(Container &container) {
+	container.shrink_to_fit();
+}
+
+template <typename Key, typename T, typename... Rest>
+void shrink_storage(std::unordered_map<Key, T, Rest...> &container) {
+	container.rehash(0);
+}
+
+template <typename Container>
+container_stats storage_memory_stats(const Container &container) {
+	return container.memory_stats();
+}
+
+// Nodes aren't visible through the interface, so this assumes one allocation per value
+// holding it and a next pointer, on top of the bucket array
+template <typename Key, typename T, typename... Rest>
+container_stats storage_memory_stats(const std::unordered_map<Key, T, Rest...> &container) {
+	using node_size = std::integral_constant<std::size_t, sizeof(std::pair<const Key, T>) + sizeof(void *)>;
+	container_stats stats;
+	stats.size = container.size();
+	stats.capacity = static_cast<std::size_t>(container.bucket_count() * container.max_load_factor());
+	stats.bytes = container.size() * node_size::value + container.bucket_count() * sizeof(void *);
+	stats.slack = (container.bucket_count() - std::min(container.bucket_count(), container.size())) * sizeof(void *);
+	return stats;
+}
+} // namespace detail
+}
@@ -0,0 +1,96 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+
+using archetype_manager = entity_manager<comps, tags, singleton_list<>, archetype_storage>;
+using archetype_entity = archetype_manager::entity_t;
+
+TEST_CASE("archetype entities", "[archetype]") {
+	archetype_manager em;
+	auto ent = em.create_entity<TA>(A{1});
+	REQUIRE(ent.get_status() == entity_status::OK);
+	REQUIRE(ent.has_component<A>());
+	REQUIRE(!ent.has_component<B>());
+	REQUIRE(ent.has_tag<TA>());
+	REQUIRE(ent.get_component<A>().x == 1);
+
+	auto copy = ent;
+	auto added = ent.add_component<B>("b");
+	REQUIRE(added.second);
+	REQUIRE(added.first.name == "b");
+	REQUIRE(copy.get_status() == entity_status::STALE);
+	REQUIRE(copy.sync());
+	REQUIRE(copy.get_component<B>().name == "b");
+	REQUIRE(ent.get_component<A>().x == 1);
+
+	REQUIRE(!ent.add_component<B>("c").second);
+	ent.get_component<A>().x = 2;
+	REQUIRE(ent.set_tag<TA>(false));
+	REQUIRE(ent.get_component<A>().x == 2);
+	REQUIRE(ent.remove_component<A>());
+	REQUIRE(!ent.remove_component<A>());
+	REQUIRE(ent.get_component<B>().name == "b");
+	REQUIRE_THROWS(ent.get_component<A>());
+
+	ent.destroy();
+	REQUIRE(ent.get_status() == entity_status::DELETED);
+}
+
+TEST_CASE("archetype for_each", "[archetype]") {
+	archetype_manager em;
+	std::vector<archetype_entity> ents;
+	for (int i = 0; i < 30; ++i) {
+		auto ent = em.create_entity(A{i});
+		if (i % 2 == 0) ent.add_component<C>(i, 0);
+		if (i % 3 == 0) ent.set_tag<TB>(true);
+		ents.push_back(ent);
+	}
+	// Migrating back and forth reuses the cached edges
+	auto tableCount = em.get_table_count();
+	ents[1].add_component<C>(1, 0);
+	ents[1].remove_component<C>();
+	REQUIRE(em.get_table_count() == tableCount);
+
+	int count = 0, sum = 0;
+	em.for_each<A, C, TB>([&](auto ent, A &a, C &c) {
+		REQUIRE(ent.template has_tag<TB>());
+		REQUIRE(a.x == c.get());
+		sum += a.x;
+		++count;
+	});
+	REQUIRE(count == 5);
+	REQUIRE(sum == 0 + 6 + 12 + 18 + 24);
+
+	auto withC = em.get_entities<C>();
+	REQUIRE(withC.size() == 15);
+	REQUIRE(std::is_sorted(withC.begin(), withC.end()));
+
+	ents[4].destroy();
+	ents[0].remove_component<C>();
+	count = 0;
+	em.for_each<A>([&](auto ent, A &a, control_block_t &control) {
+		REQUIRE(ent.template get_component<A>().x == a.x);
+		if (++count == 20) control.breakout = true;
+	});
+	REQUIRE(count == 20);
+	REQUIRE(em.get_entities<C>().size() == 13);
+	REQUIRE(em.get_entities<A>().size() == 29);
+}
+
+TEST_CASE("archetype singletons", "[archetype]") {
+	struct frame_count {
+		int frames = 0;
+	};
+	entity_manager<comps, tags, singleton_list<frame_count>, archetype_storage> em;
+	em.singleton<frame_count>().frames = 3;
+	em.create_entity(A{2});
+	em.create_entity(A{4}, B{"b"});
+	int sum = 0;
+	em.for_each<frame_count, A>([&](auto, frame_count &frames, A &a) {
+		sum += frames.frames * a.x;
+	});
+	REQUIRE(sum == 18);
+}
@@ -139,3 +139,132 @@ TEST_CASE("set invariance", "[flat_map]") {
 						   eq.begin(), eq.end()));
 	}
 }
+
+TEST_CASE("dense map", "[dense_map]") {
+	entityplus::dense_map<int, float> map;
+	REQUIRE(map.empty());
+	REQUIRE(map.emplace(3, 3.f).second);
+	REQUIRE(map.emplace(1, 1.f).second);
+	REQUIRE(map.emplace(2, 2.f).second);
+	REQUIRE(!map.emplace(2, 5.f).second);
+	REQUIRE(map.size() == 3);
+	REQUIRE(map.find(2)->second == 2.f);
+	REQUIRE(map.find(4) == map.end());
+	REQUIRE(!map.has_custom_order());
+
+	int count = 1;
+	for (const auto &idx : map.get_index()) {
+		REQUIRE(idx.first == count++);
+		REQUIRE((map.begin() + idx.second)->first == idx.first);
+	}
+
+	REQUIRE(map.erase(3) == 1);
+	REQUIRE(map.erase(3) == 0);
+	REQUIRE(map.size() == 2);
+	REQUIRE(map.find(1)->second == 1.f);
+	REQUIRE(map.find(2)->second == 2.f);
+}
+
+TEST_CASE("dense map sort", "[dense_map]") {
+	entityplus::dense_map<int, int> map;
+	for (int i = 0; i < 10; ++i) map.emplace(i, (i * 7) % 10);
+	map.sort(std::less<int>{});
+	REQUIRE(map.has_custom_order());
+	REQUIRE(std::is_sorted(map.begin(), map.end(), [](const auto &lhs, const auto &rhs) {
+		return lhs.second < rhs.second;
+	}));
+	for (int i = 0; i < 10; ++i) REQUIRE(map.find(i)->second == (i * 7) % 10);
+
+	map.insertion_sort(std::greater<int>{});
+	REQUIRE(std::is_sorted(map.begin(), map.end(), [](const auto &lhs, const auto &rhs) {
+		return lhs.second > rhs.second;
+	}));
+	for (int i = 0; i < 10; ++i) REQUIRE(map.find(i)->second == (i * 7) % 10);
+
+	entityplus::dense_map<int, char> follower;
+	follower.emplace(11, 'x');
+	follower.emplace(3, 'a');
+	follower.emplace(5, 'b');
+	follower.arrange_like(map);
+	std::vector<int> order;
+	for (const auto &val : follower) order.push_back(val.first);
+	REQUIRE((order == std::vector<int>{5, 3, 11}));
+	REQUIRE(follower.find(3)->second == 'a');
+}
+
+TEST_CASE("sparse map", "[sparse_map]") {
+	entityplus::sparse_map<unsigned, float> map;
+	REQUIRE(map.empty());
+	REQUIRE(map.emplace(30, 3.f).second);
+	REQUIRE(map.emplace(1, 1.f).second);
+	REQUIRE(map.emplace(2, 2.f).second);
+	REQUIRE(!map.emplace(2, 5.f).second);
+	REQUIRE(map.size() == 3);
+	REQUIRE(map.find(2)->second == 2.f);
+	REQUIRE(map.find(4) == map.end());
+	REQUIRE(map.find(100) == map.end());
+
+	REQUIRE(map.erase(30) == 1);
+	REQUIRE(map.erase(30) == 0);
+	REQUIRE(map.size() == 2);
+	REQUIRE(map.find(1)->second == 1.f);
+	REQUIRE(map.find(2)->second == 2.f);
+	REQUIRE(map.emplace(30, 4.f).second);
+	REQUIRE(map.find(30)->second == 4.f);
+}
+
+TEST_CASE("paged map", "[paged_map]") {
+	entityplus::paged_map<int, int, 4> map;
+	REQUIRE(map.empty());
+	for (int i = 0; i < 10; ++i) REQUIRE(map.emplace(9 - i, i).second);
+	REQUIRE(!map.emplace(3, 0).second);
+	REQUIRE(map.size() == 10);
+	// Pages don't move once allocated
+	const int *first = &map.find(9)->second;
+	for (int i = 10; i < 50; ++i) map.emplace(i, i);
+	REQUIRE(&map.find(9)->second == first);
+
+	int count = 0;
+	for (const auto &idx : map.get_index()) {
+		REQUIRE(idx.first == count++);
+		REQUIRE((map.begin() + idx.second)->first == idx.first);
+	}
+	REQUIRE(std::distance(map.begin(), map.end()) == 50);
+
+	for (int i = 0; i < 50; i += 2) REQUIRE(map.erase(i) == 1);
+	REQUIRE(map.erase(0) == 0);
+	REQUIRE(map.size() == 25);
+	for (int i = 1; i < 50; i += 2) REQUIRE(map.find(i)->first == i);
+	for (int i = 1; i < 50; i += 2) map.erase(i);
+	REQUIRE(map.empty());
+	REQUIRE(map.begin() == map.end());
+}
+
+TEST_CASE("bit vector", "[bit_vector]") {
+	entityplus::bit_vector bits;
+	REQUIRE(bits.empty());
+	for (int i = 0; i < 200; ++i) bits.push_back(i % 3 == 0);
+	REQUIRE(bits.size() == 200);
+	REQUIRE(bits.count() == 67);
+	REQUIRE(bits.word_count() == 4);
+	bits.set(1, true);
+	bits.set(1, true);
+	REQUIRE(bits.count() == 68);
+	bits.set(1, false);
+
+	// Shifts every later bit down, including across words
+	bits.erase(63);
+	bits.erase(0);
+	REQUIRE(bits.size() == 198);
+	REQUIRE(bits.count() == 65);
+	for (std::size_t i = 0; i < bits.size(); ++i) {
+		auto old = i < 62 ? i + 1 : i + 2;
+		REQUIRE(bits.test(i) == (old % 3 == 0));
+	}
+
+	while (bits.size() > 128) bits.erase(bits.size() - 1);
+	REQUIRE(bits.word_count() == 2);
+	bits.clear();
+	REQUIRE(bits.count() == 0);
+	REQUIRE(bits.word_count() == 0);
+}
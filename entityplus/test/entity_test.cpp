@@ -83,6 +83,38 @@ TEST_CASE("components", "[entity]") {
 	REQUIRE(!ent.has_component<C>());
 }
 
+TEST_CASE("component handles", "[entity]") {
+	using manager_t = entity_manager<comps, tag_list<>>;
+	manager_t em;
+#ifdef ENTITYPLUS_NO_EXCEPTIONS
+	em.set_error_callback(error_handler);
+#endif
+	auto ent = em.create_entity(A{1});
+	REQUIRE_THROWS(ent.get_handle<B>());
+
+	manager_t::component_handle<A> handle = ent.get_handle<A>();
+	REQUIRE(handle.is_valid());
+	REQUIRE(handle.get_entity() == ent);
+	REQUIRE(handle.get().x == 1);
+	handle.get().x = 2;
+	REQUIRE(ent.get_component<A>().x == 2);
+
+	// Moving the value around must be picked up by the handle
+	for (int i = 0; i < 20; ++i) em.create_entity(A{i + 10});
+	em.sort<A>([](const A &lhs, const A &rhs) { return lhs.x > rhs.x; });
+	REQUIRE((*handle).x == 2);
+	auto other = em.create_entity(A{3}, B{"b"});
+	auto otherHandle = other.get_handle<A>();
+	ent.add_component<B>("a");
+	REQUIRE(otherHandle.get().x == 3);
+
+	other.destroy();
+	REQUIRE_THROWS(otherHandle.get());
+	REQUIRE(handle.get().x == 2);
+	ent.remove_component<A>();
+	REQUIRE_THROWS(handle.get());
+}
+
 TEST_CASE("tags", "[entity]") {
 	entity_manager<component_list<>, tags> em;
 #ifdef ENTITYPLUS_NO_EXCEPTIONS
@@ -133,6 +165,68 @@ TEST_CASE("stale entity", "[entity]") {
 	REQUIRE_THROWS(entCopy.set_tag<TA>(true));
 }
 
+TEST_CASE("tag bitmaps", "[entity]") {
+	entity_manager<comps, tags> em;
+	std::vector<entity_manager<comps, tags>::entity_t> ents;
+	for (int i = 0; i < 300; ++i) {
+		auto ent = em.create_entity(A{i});
+		ent.set_tag<TA>(i % 2 == 0);
+		ent.set_tag<TB>(i % 3 == 0);
+		ents.push_back(ent);
+	}
+	int visited = 0;
+	auto countVisit = [&](auto ent) {
+		REQUIRE(ent.get_status() == entity_status::OK);
+		++visited;
+	};
+	em.for_each<TA, TB>(countVisit);
+	REQUIRE(visited == 50);
+	REQUIRE(em.get_entities<TA, TB>().size() == 50);
+
+	// Destroying shifts the positions of every later entity
+	for (int i = 0; i < 300; i += 7) ents[i].destroy();
+	int expected = 0;
+	for (int i = 0; i < 300; ++i) {
+		if (i % 7 != 0 && i % 6 == 0) ++expected;
+	}
+	visited = 0;
+	em.for_each<TA, TB>(countVisit);
+	REQUIRE(visited == expected);
+	auto both = em.get_entities<TA, TB>();
+	REQUIRE(both.size() == static_cast<std::size_t>(expected));
+	REQUIRE(std::is_sorted(both.begin(), both.end()));
+
+	// Entities handed out through a grouping are current after their tags changed
+	auto grouping = em.create_grouping<A, TA>();
+	for (int i = 1; i < 300; i += 2) {
+		if (i % 7 != 0) ents[i].set_tag<TA>(true);
+	}
+	visited = 0;
+	em.for_each<A, TA>([&](auto ent, A &a) {
+		REQUIRE(ent.get_status() == entity_status::OK);
+		REQUIRE(ent.template has_tag<TA>());
+		REQUIRE(a.x % 7 != 0);
+		++visited;
+	});
+	REQUIRE(visited == 300 - 43);
+	for (auto &&row : em.query<A, TB>()) {
+		REQUIRE(std::get<0>(row).get_status() == entity_status::OK);
+		REQUIRE(std::get<1>(row).x % 3 == 0);
+	}
+
+	iteration_cursor cursor;
+	visited = 0;
+	while (!em.for_each_budgeted<TB>(cursor, 10, [&](auto) { ++visited; }));
+	REQUIRE(visited == 100 - 15);
+
+	for (auto &ent : ents) {
+		if (ent.get_status() == entity_status::OK) ent.set_tag<TB>(false);
+	}
+	visited = 0;
+	em.for_each<TB>(countVisit);
+	REQUIRE(visited == 0);
+}
+
 TEST_CASE("get_entities", "[entity]") {
 	SECTION("by type") {
 		entity_manager<comps, tags> em;
@@ -242,6 +336,174 @@ TEST_CASE("for_each with control", "[entity]") {
 }
 
 
+TEST_CASE("sort components", "[entity]") {
+	entity_manager<comps, tags> em;
+	for (int i = 0; i < 6; ++i) {
+		auto ent = em.create_entity(A{(i * 5) % 6});
+		if (i % 2 == 0) ent.add_component<B>(std::to_string(i));
+		if (i % 3 == 0) ent.set_tag<TA>(true);
+	}
+
+	std::vector<int> order;
+	em.for_each<A>([&](auto, auto &a) { order.push_back(a.x); });
+	REQUIRE((order == std::vector<int>{0, 5, 4, 3, 2, 1}));
+
+	em.sort<A, B>([](const A &lhs, const A &rhs) { return lhs.x < rhs.x; });
+	order.clear();
+	em.for_each<A>([&](auto, auto &a) { order.push_back(a.x); });
+	REQUIRE((order == std::vector<int>{0, 1, 2, 3, 4, 5}));
+
+	order.clear();
+	std::vector<std::string> names;
+	em.for_each<A, B>([&](auto ent, auto &a, auto &b) {
+		REQUIRE(&ent.template get_component<B>() == &b);
+		order.push_back(a.x);
+		names.push_back(b.name);
+	});
+	REQUIRE((order == std::vector<int>{0, 2, 4}));
+	REQUIRE((names == std::vector<std::string>{"0", "4", "2"}));
+
+	order.clear();
+	em.for_each<A, TA>([&](auto, auto &a) { order.push_back(a.x); });
+	REQUIRE((order == std::vector<int>{0, 3}));
+
+	em.create_entity(A{-1});
+	em.insertion_sort<A>([](const A &lhs, const A &rhs) { return lhs.x < rhs.x; });
+	order.clear();
+	em.for_each<A>([&](auto, auto &a, auto &control) {
+		order.push_back(a.x);
+		if (a.x == 1) control.breakout = true;
+	});
+	REQUIRE((order == std::vector<int>{-1, 0, 1}));
+
+	// B followed the first sort of A
+	order.clear();
+	em.for_each<B, A>([&](auto, auto &, auto &a) { order.push_back(a.x); });
+	REQUIRE((order == std::vector<int>{0, 2, 4}));
+
+	// Id order is used when the first component is unsorted
+	for (auto ent : em.get_entities<A>()) ent.add_component<C>(ent.get_component<A>().x, 0);
+	order.clear();
+	em.for_each<C, A>([&](auto, auto &, auto &a) { order.push_back(a.x); });
+	REQUIRE((order == std::vector<int>{0, 5, 4, 3, 2, 1, -1}));
+}
+TEST_CASE("for_each_budgeted", "[entity]") {
+	entity_manager<comps, tags> em;
+	std::vector<entity_manager<comps, tags>::entity_t> ents;
+	for (int i = 0; i < 5; ++i) ents.push_back(em.create_entity(A{i}));
+
+	iteration_cursor cursor;
+	REQUIRE(cursor.at_start());
+	std::vector<int> seen;
+	auto record = [&](auto, auto &a) { seen.push_back(a.x); };
+	REQUIRE(!em.for_each_budgeted<A>(cursor, 2, record));
+	REQUIRE(!cursor.at_start());
+	REQUIRE((seen == std::vector<int>{0, 1}));
+
+	// Changes between slices are picked up
+	ents[2].destroy();
+	em.create_entity(A{5});
+	REQUIRE(!em.for_each_budgeted<A>(cursor, 2, record));
+	REQUIRE((seen == std::vector<int>{0, 1, 3, 4}));
+	REQUIRE(em.for_each_budgeted<A>(cursor, 2, record));
+	REQUIRE((seen == std::vector<int>{0, 1, 3, 4, 5}));
+	REQUIRE(cursor.at_start());
+
+	seen.clear();
+	REQUIRE(em.for_each_budgeted<A>(cursor, std::chrono::steady_clock::now() + std::chrono::hours(1), record));
+	REQUIRE((seen == std::vector<int>{0, 1, 3, 4, 5}));
+
+	seen.clear();
+	REQUIRE(!em.for_each_budgeted<A>(cursor, std::chrono::steady_clock::time_point{}, record));
+	REQUIRE((seen == std::vector<int>{0}));
+
+	seen.clear();
+	cursor.reset();
+	ents[3].set_tag<TB>(true);
+	REQUIRE(!em.for_each_budgeted<A, TB>(cursor, 5, [&](auto, auto &a, auto &control) {
+		seen.push_back(a.x);
+		control.breakout = true;
+	}));
+	REQUIRE(em.for_each_budgeted<A, TB>(cursor, 5, record));
+	REQUIRE((seen == std::vector<int>{3}));
+}
+TEST_CASE("query", "[entity]") {
+	entity_manager<comps, tags> em;
+	REQUIRE(em.query<A>().empty());
+	for (int i = 0; i < 6; ++i) {
+		auto ent = em.create_entity(A{i});
+		if (i % 2 == 0) ent.add_component<B>(std::to_string(i));
+		if (i % 3 == 0) ent.set_tag<TA>(true);
+	}
+
+	std::vector<int> seen;
+	for (auto row : em.query<A, B>()) {
+		REQUIRE(std::get<0>(row).template get_component<B>().name == std::get<2>(row).name);
+		seen.push_back(std::get<1>(row).x);
+	}
+	REQUIRE((seen == std::vector<int>{0, 2, 4}));
+
+	auto range = em.query<A, TA>();
+	auto found = std::find_if(range.begin(), range.end(), [](const auto &row) {
+		return std::get<1>(row).x > 0;
+	});
+	REQUIRE(found != range.end());
+	REQUIRE(std::get<1>(*found).x == 3);
+	std::get<1>(*found).x = 30;
+	REQUIRE(std::get<0>(*found).template get_component<A>().x == 30);
+	REQUIRE(std::distance(range.begin(), range.end()) == 2);
+
+	// Both ranges are in id order, so they can be merge joined
+	auto lhs = em.query<B>();
+	auto rhs = em.query<TA>();
+	auto l = lhs.begin();
+	auto r = rhs.begin();
+	int joined = 0;
+	while (l != lhs.end() && r != rhs.end()) {
+		if (std::get<0>(*l) < std::get<0>(*r)) ++l;
+		else if (std::get<0>(*r) < std::get<0>(*l)) ++r;
+		else {
+			++joined;
+			++l, ++r;
+		}
+	}
+	REQUIRE(joined == 1);
+}
+TEST_CASE("singletons", "[entity]") {
+	struct game_time {
+		float dt = 0;
+	};
+	entity_manager<comps, tags, singleton_list<game_time, int>> em;
+	REQUIRE(em.singleton<game_time>().dt == 0);
+	em.singleton<game_time>().dt = 0.5f;
+	em.singleton<int>() = 2;
+	const auto &constEm = em;
+	REQUIRE(constEm.singleton<game_time>().dt == 0.5f);
+
+	em.create_entity<TA>(A{1});
+	em.create_entity(A{2});
+
+	int sum = 0;
+	em.for_each<A, game_time>([&](auto, auto &a, auto &time) {
+		sum += a.x;
+		REQUIRE(time.dt == 0.5f);
+	});
+	REQUIRE(sum == 3);
+
+	sum = 0;
+	em.for_each<int, TA, A>([&](auto, int &mult, auto &a, auto &control) {
+		sum += mult * a.x;
+		control.breakout = true;
+	});
+	REQUIRE(sum == 2);
+
+	int count = 0;
+	em.for_each<game_time>([&](auto ent, auto &) {
+		REQUIRE(ent.get_status() == entity_status::OK);
+		++count;
+	});
+	REQUIRE(count == 2);
+}
 
 TEST_CASE("entity metafunction", "[entity]") {
 	//entity_manager<int, float> em;
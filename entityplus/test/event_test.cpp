@@ -5,6 +5,8 @@
 
 #include "test_common.h"
 #include <entityplus/event.h>
+#include <thread>
+#include <sstream>
 
 using entityplus::event_manager;
 using entityplus::subscriber_handle;
@@ -12,6 +14,34 @@ using entityplus::subscriber_handle;
 template <typename... Ts>
 using empty_manager = event_manager<component_list<>, tag_list<>, Ts...>;
 
+struct quiet {
+	int x;
+};
+
+struct journal_hit {
+	int damage;
+};
+
+struct journal_chat {
+	std::string text;
+};
+
+namespace entityplus {
+template <typename Entity>
+struct entity_event_traits<component_added<Entity, quiet>> : std::false_type {};
+
+template <>
+struct event_serializer<journal_chat> {
+	static void write(std::vector<char> &out, const journal_chat &chat) {
+		out.insert(out.end(), chat.text.begin(), chat.text.end());
+	}
+
+	static journal_chat read(const char *data, std::size_t size) {
+		return {std::string(data, size)};
+	}
+};
+}
+
 TEST_CASE("receiving", "[event]") {
 	empty_manager<int, float> em;
 	bool wasCalled = false, wasCalled2 = false;
@@ -165,3 +195,487 @@ TEST_CASE("tag event", "[event]") {
 	REQUIRE(tagsAdded == 3);
 	REQUIRE(tagsRemoved == 3);
 }
+
+namespace {
+void count_event(void *context, const int &x) {
+	*static_cast<int *>(context) += x;
+}
+}
+
+TEST_CASE("function pointer subscribers", "[event]") {
+	empty_manager<int> em;
+	int sum = 0, calls = 0;
+	auto sub1 = em.subscribe<int>(&count_event, &sum);
+	auto sub2 = em.subscribe<int>([&](int) { ++calls; });
+	em.broadcast(3);
+	em.broadcast(4);
+	REQUIRE(sum == 7);
+	REQUIRE(calls == 2);
+	REQUIRE(sub1.unsubscribe());
+	em.broadcast(5);
+	REQUIRE(sum == 7);
+	REQUIRE(calls == 3);
+}
+
+TEST_CASE("delegate", "[event]") {
+	using int_delegate = detail::delegate<int(int)>;
+	auto counter = std::make_shared<int>(10);
+	int_delegate empty;
+	REQUIRE(!empty);
+	{
+		int_delegate add([counter](int x) { return *counter + x; });
+		REQUIRE(counter.use_count() == 2);
+		REQUIRE(add(1) == 11);
+
+		auto copy = add;
+		REQUIRE(counter.use_count() == 3);
+		int_delegate moved(std::move(add));
+		REQUIRE(moved(2) == 12);
+		copy = std::move(moved);
+		REQUIRE(copy(3) == 13);
+		REQUIRE(counter.use_count() == 2);
+		empty = copy;
+		REQUIRE(empty(4) == 14);
+		empty = int_delegate{};
+		REQUIRE(!empty);
+	}
+	REQUIRE(counter.use_count() == 1);
+
+	int factor = 3;
+	int_delegate fromPointer([](void *context, int x) { return *static_cast<int *>(context) * x; }, &factor);
+	auto pointerCopy = fromPointer;
+	factor = 4;
+	REQUIRE(pointerCopy(2) == 8);
+}
+
+TEST_CASE("queued events", "[event]") {
+	empty_manager<int, float> em;
+	std::vector<int> order;
+	std::size_t batches = 0;
+	em.subscribe<int>([&](int x) { order.push_back(x); });
+	auto batchSub = em.subscribe_batch<int>([&](event_span<int> batch) {
+		++batches;
+		for (auto x : batch) order.push_back(-x);
+	});
+	em.enqueue(1);
+	em.enqueue(2);
+	REQUIRE(order.empty());
+	em.dispatch();
+	// One pass over the whole batch per subscriber
+	REQUIRE((order == std::vector<int>{1, 2, -1, -2}));
+	REQUIRE(batches == 1);
+
+	// Broadcasts still reach batch subscribers, one event at a time
+	order.clear();
+	em.broadcast(3);
+	REQUIRE((order == std::vector<int>{3, -3}));
+	em.dispatch();
+	REQUIRE(batches == 2);
+
+	// Events enqueued while dispatching wait for the next dispatch
+	order.clear();
+	REQUIRE(batchSub.unsubscribe());
+	em.subscribe<float>([&](float) { em.enqueue(10); });
+	em.set_queued<float>(true);
+	em.broadcast(1.f);
+	em.dispatch();
+	REQUIRE(order.empty());
+	em.dispatch();
+	REQUIRE((order == std::vector<int>{10}));
+	em.set_queued<float>(false);
+	em.broadcast(1.f);
+	REQUIRE((order == std::vector<int>{10}));
+	em.dispatch();
+	REQUIRE((order == std::vector<int>{10, 10}));
+}
+
+TEST_CASE("queued entity events", "[event]") {
+	using queued_manager = entity_manager<comps, tags>;
+	using entity_t = queued_manager::entity_t;
+	queued_manager entMan;
+	event_manager<comps, tags> evtMan;
+	entMan.set_event_manager(evtMan);
+	evtMan.set_queued<component_added<entity_t, A>>(true);
+	evtMan.set_queued<component_removed<entity_t, A>>(true);
+	evtMan.set_queued<tag_added<entity_t, TA>>(true);
+
+	std::vector<int> added, removed;
+	int tagged = 0;
+	evtMan.subscribe<component_added<entity_t, A>>([&](const auto &event) {
+		// The entity may have changed since the event was queued
+		auto ent = event.entity;
+		REQUIRE(ent.sync());
+		ent.template set_tag<TB>(true);
+		added.push_back(event.component.x);
+	});
+	evtMan.subscribe_batch<component_removed<entity_t, A>>([&](auto batch) {
+		for (const auto &event : batch) {
+			REQUIRE(event.entity.get_status() == entity_status::DELETED);
+			removed.push_back(event.component.x);
+		}
+	});
+	evtMan.subscribe<tag_added<entity_t, TA>>([&](const auto &) { ++tagged; });
+
+	auto ent1 = entMan.create_entity<TA>(A{1});
+	auto ent2 = entMan.create_entity(A{2});
+	ent2.get_component<A>().x = 5;
+	REQUIRE(added.empty());
+	REQUIRE(tagged == 0);
+	evtMan.dispatch();
+	// The component is copied when the event is queued
+	REQUIRE((added == std::vector<int>{1, 2}));
+	REQUIRE(tagged == 1);
+	REQUIRE(entMan.get_entities<TB>().size() == 2);
+
+	REQUIRE(ent1.sync());
+	REQUIRE(ent2.sync());
+	ent1.destroy();
+	ent2.destroy();
+	REQUIRE(removed.empty());
+	evtMan.dispatch();
+	REQUIRE((removed == std::vector<int>{1, 5}));
+	evtMan.dispatch();
+	REQUIRE(removed.size() == 2);
+}
+
+TEST_CASE("inactive entity events", "[event]") {
+	using quiet_manager = entity_manager<component_list<A, quiet>, tags>;
+	using entity_t = quiet_manager::entity_t;
+	quiet_manager entMan;
+	event_manager<component_list<A, quiet>, tags> evtMan;
+	entMan.set_event_manager(evtMan);
+	int destroyed = 0, removed = 0, quietAdded = 0, quietRemoved = 0;
+	evtMan.subscribe<entity_destroyed<entity_t>>([&](const auto &) { ++destroyed; });
+	// Compiled out by entity_event_traits
+	evtMan.subscribe<component_added<entity_t, quiet>>([&](const auto &) { ++quietAdded; });
+	evtMan.subscribe<component_removed<entity_t, quiet>>([&](const auto &) { ++quietRemoved; });
+
+	auto ent1 = entMan.create_entity<TA>(A{1}, quiet{2});
+	auto ent2 = entMan.create_entity<TA>(A{1});
+	ent1.destroy();
+	REQUIRE(destroyed == 1);
+	REQUIRE(quietAdded == 0);
+	REQUIRE(quietRemoved == 1);
+
+	// Subscribing turns the event back on, unsubscribing the last subscriber turns it off
+	auto sub = evtMan.subscribe_batch<component_removed<entity_t, A>>([&](auto batch) { removed += int(batch.size()); });
+	entMan.clone(ent2).destroy();
+	REQUIRE(removed == 1);
+	REQUIRE(sub.unsubscribe());
+	entMan.clone(ent2).destroy();
+	REQUIRE(removed == 1);
+	REQUIRE(destroyed == 3);
+	evtMan.set_queued<component_removed<entity_t, A>>(true);
+	sub = evtMan.subscribe_batch<component_removed<entity_t, A>>([&](auto batch) { removed += int(batch.size()); });
+	entMan.clear();
+	REQUIRE(removed == 1);
+	evtMan.dispatch();
+	REQUIRE(removed == 2);
+	REQUIRE(destroyed == 4);
+}
+
+TEST_CASE("event producers", "[event]") {
+	empty_manager<int, float> em;
+	std::vector<int> ints;
+	float floats = 0;
+	em.subscribe<int>([&](int x) { ints.push_back(x); });
+	em.subscribe<float>([&](float x) { floats += x; });
+
+	constexpr int ThreadCount = 4, PerThread = 1000;
+	std::vector<empty_manager<int, float>::producer_t> producers;
+	for (int i = 0; i < ThreadCount; ++i) producers.push_back(em.make_producer());
+	std::vector<std::thread> threads;
+	for (int i = 0; i < ThreadCount; ++i) {
+		threads.emplace_back([&, i] {
+			auto &producer = producers[i];
+			for (int j = 0; j < PerThread; ++j) {
+				producer.enqueue(i * PerThread + j);
+				if (j % 100 == 99) {
+					producer.enqueue(1.f);
+					producer.flush();
+				}
+			}
+		});
+	}
+	for (auto &thread : threads) thread.join();
+	REQUIRE(ints.empty());
+	em.enqueue(-1);
+
+	// The manager's own events come first, then every producer's in the order they were made
+	em.dispatch();
+	REQUIRE(ints.size() == ThreadCount * PerThread + 1);
+	REQUIRE(ints.front() == -1);
+	REQUIRE(std::is_sorted(ints.begin(), ints.end()));
+	REQUIRE(floats == ThreadCount * PerThread / 100);
+
+	// Unflushed events stay with the producer until it's flushed or destroyed
+	producers[0].enqueue(5);
+	em.dispatch();
+	REQUIRE(ints.size() == ThreadCount * PerThread + 1);
+	producers.clear();
+	em.dispatch();
+	REQUIRE(ints.back() == 5);
+}
+
+TEST_CASE("parallel dispatch", "[event]") {
+	empty_manager<int> em;
+	constexpr int SubscriberCount = 8;
+	std::vector<int> sums(SubscriberCount, 0);
+	std::vector<int> serialOrder;
+	for (int i = 0; i < SubscriberCount; ++i) {
+		auto &sum = sums[i];
+		em.subscribe_parallel<int>([&sum](int x) { sum += x; });
+	}
+	em.subscribe<int>([&](int x) { serialOrder.push_back(x); });
+	em.subscribe_batch<int>([&](event_span<int> batch) { serialOrder.push_back(-int(batch.size())); });
+
+	std::vector<int> events(100);
+	std::iota(events.begin(), events.end(), 0);
+	em.dispatch_parallel(event_span<int>{events.data(), events.size()}, 4);
+	for (auto sum : sums) REQUIRE(sum == 4950);
+	REQUIRE(serialOrder.size() == 101);
+	REQUIRE(serialOrder.back() == -100);
+	REQUIRE(std::is_sorted(serialOrder.begin(), serialOrder.end() - 1));
+
+	// Parallel subscribers are ordinary subscribers everywhere else
+	em.broadcast(1);
+	for (auto sum : sums) REQUIRE(sum == 4951);
+
+	auto throwing = em.subscribe_parallel<int>([](int) { throw 5; });
+	REQUIRE_THROWS(em.dispatch_parallel(event_span<int>{events.data(), events.size()}, 2));
+	for (auto sum : sums) REQUIRE(sum == 9901);
+	REQUIRE(throwing.unsubscribe());
+	em.dispatch_parallel(event_span<int>{events.data(), 2}, 1);
+	for (auto sum : sums) REQUIRE(sum == 9902);
+}
+
+TEST_CASE("targeted subscribers", "[event]") {
+	using targeted_manager = entity_manager<comps, tags>;
+	using entity_t = targeted_manager::entity_t;
+	targeted_manager entMan;
+	event_manager<comps, tags> evtMan;
+	entMan.set_event_manager(evtMan);
+
+	auto ent1 = entMan.create_entity();
+	auto ent2 = entMan.create_entity<TA>();
+	std::vector<int> calls;
+	evtMan.subscribe<component_added<entity_t, A>>([&](const auto &) { calls.push_back(0); });
+	auto forEnt1 = evtMan.subscribe_for<component_added<entity_t, A>>(ent1, [&](const auto &event) {
+		REQUIRE(event.entity == ent1);
+		calls.push_back(1);
+	});
+	auto withTA = evtMan.subscribe_with_tag<component_added<entity_t, A>, TA>([&](const auto &event) {
+		REQUIRE(event.entity.template has_tag<TA>());
+		calls.push_back(2);
+	});
+
+	ent1.add_component<A>(1);
+	REQUIRE((calls == std::vector<int>{0, 1}));
+	calls.clear();
+	ent2.add_component<A>(2);
+	REQUIRE((calls == std::vector<int>{0, 2}));
+	calls.clear();
+	ent1.remove_component<A>();
+	ent1.set_tag<TA>(true);
+	ent1.add_component<A>(3);
+	REQUIRE((calls == std::vector<int>{0, 1, 2}));
+
+	// Queued events reach them too
+	calls.clear();
+	evtMan.set_queued<component_added<entity_t, A>>(true);
+	REQUIRE(forEnt1.unsubscribe());
+	ent2.remove_component<A>();
+	ent2.add_component<A>(4);
+	auto ent3 = entMan.create_entity(A{5});
+	evtMan.dispatch();
+	REQUIRE((calls == std::vector<int>{0, 0, 2}));
+
+	int destroyed = 0;
+	evtMan.subscribe_for<entity_destroyed<entity_t>>(ent3, [&](const auto &) { ++destroyed; });
+	ent2.destroy();
+	REQUIRE(destroyed == 0);
+	ent3.destroy();
+	REQUIRE(destroyed == 1);
+	REQUIRE(withTA.unsubscribe());
+}
+
+TEST_CASE("coalesced events", "[event]") {
+	using coalesced_manager = entity_manager<comps, tags>;
+	using entity_t = coalesced_manager::entity_t;
+	coalesced_manager entMan;
+	event_manager<comps, tags> evtMan;
+	entMan.set_event_manager(evtMan);
+	evtMan.set_coalescing(true);
+
+	std::vector<int> added, removed;
+	int tagsAdded = 0, tagsRemoved = 0, created = 0;
+	evtMan.subscribe<component_added<entity_t, A>>([&](const auto &event) { added.push_back(event.component.x); });
+	evtMan.subscribe<component_removed<entity_t, A>>([&](const auto &event) { removed.push_back(event.component.x); });
+	evtMan.subscribe<tag_added<entity_t, TA>>([&](const auto &) { ++tagsAdded; });
+	evtMan.subscribe<tag_removed<entity_t, TA>>([&](const auto &) { ++tagsRemoved; });
+	evtMan.subscribe<entity_created<entity_t>>([&](const auto &) { ++created; });
+
+	auto ent1 = entMan.create_entity<TA>(A{1});
+	auto ent2 = entMan.create_entity(A{2});
+	// Other events aren't held back
+	REQUIRE(created == 2);
+	ent2.remove_component<A>();
+	ent2.set_tag<TA>(true);
+	ent2.set_tag<TA>(false);
+	REQUIRE(added.empty());
+	evtMan.dispatch();
+	REQUIRE((added == std::vector<int>{1}));
+	REQUIRE(removed.empty());
+	REQUIRE(tagsAdded == 1);
+	REQUIRE(tagsRemoved == 0);
+
+	// Replacing a component reports the old and the last value
+	added.clear();
+	ent1.remove_component<A>();
+	ent1.add_component<A>(3);
+	ent1.remove_component<A>();
+	ent1.add_component<A>(4);
+	ent1.set_tag<TA>(false);
+	ent1.set_tag<TA>(true);
+	ent1.set_tag<TA>(false);
+	evtMan.dispatch();
+	REQUIRE((removed == std::vector<int>{1}));
+	REQUIRE((added == std::vector<int>{4}));
+	REQUIRE(tagsRemoved == 1);
+	evtMan.dispatch();
+	REQUIRE(removed.size() == 1);
+
+	// Changes made by the handlers wait for the next dispatch
+	auto sub = evtMan.subscribe<tag_added<entity_t, TB>>([&](const auto &event) {
+		auto ent = event.entity;
+		REQUIRE(ent.sync());
+		ent.template add_component<A>(6);
+	});
+	ent2.set_tag<TB>(true);
+	evtMan.dispatch();
+	REQUIRE(added.back() == 4);
+	evtMan.dispatch();
+	REQUIRE(added.back() == 6);
+	REQUIRE(sub.unsubscribe());
+
+	evtMan.set_coalescing(false);
+	REQUIRE(ent2.sync());
+	ent2.remove_component<A>();
+	REQUIRE(removed.back() == 6);
+}
+
+TEST_CASE("event journal", "[event]") {
+	using journal_manager = entity_manager<comps, tags>;
+	using entity_t = journal_manager::entity_t;
+	using events_t = event_manager<comps, tags, journal_hit, journal_chat>;
+	journal_manager entMan;
+	events_t recorded;
+	entMan.set_event_manager(recorded);
+	event_journal<comps, tags, journal_hit, journal_chat> journal;
+	journal.attach(recorded);
+
+	recorded.broadcast(journal_hit{1});
+	recorded.broadcast(journal_chat{"hello"});
+	auto ent = entMan.create_entity(A{1});
+	journal.begin_frame();
+	recorded.enqueue(journal_hit{2});
+	recorded.dispatch();
+	auto producer = recorded.make_producer();
+	producer.enqueue(journal_chat{"from a producer"});
+	producer.flush();
+	recorded.dispatch();
+	// Component events aren't journaled
+	ent.add_component<B>("b");
+	journal.detach();
+	recorded.broadcast(journal_hit{3});
+	REQUIRE(journal.frame_count() == 2);
+
+	std::stringstream stream;
+	journal.save(stream);
+	event_journal<comps, tags, journal_hit, journal_chat> loaded;
+	REQUIRE(loaded.load(stream));
+	REQUIRE(loaded.frame_count() == 2);
+	REQUIRE(loaded.size_bytes() == journal.size_bytes());
+
+	events_t replayed;
+	std::vector<std::string> seen;
+	replayed.subscribe<journal_hit>([&](const journal_hit &hit) { seen.push_back(std::to_string(hit.damage)); });
+	replayed.subscribe<journal_chat>([&](const journal_chat &chat) { seen.push_back(chat.text); });
+	replayed.subscribe<entity_created<entity_t>>([&](const auto &event) {
+		REQUIRE(event.entity == ent);
+		seen.push_back("created");
+	});
+	replayed.subscribe<component_added<entity_t, B>>([&](const auto &) { seen.push_back("added"); });
+	loaded.replay(replayed);
+	REQUIRE((seen == std::vector<std::string>{"1", "hello", "created", "2", "from a producer"}));
+
+	seen.clear();
+	loaded.replay(replayed, 1, 2);
+	REQUIRE((seen == std::vector<std::string>{"2", "from a producer"}));
+
+	// Replayed events follow the queues of the event manager
+	seen.clear();
+	replayed.set_queued<journal_hit>(true);
+	loaded.replay(replayed, 0, 1);
+	REQUIRE((seen == std::vector<std::string>{"hello", "created"}));
+	replayed.dispatch();
+	REQUIRE(seen.back() == "1");
+
+	std::stringstream other;
+	event_journal<comps, tags, journal_hit> mismatched;
+	mismatched.save(other);
+	REQUIRE(!loaded.load(other));
+	REQUIRE(loaded.frame_count() == 2);
+	std::stringstream garbage("not a journal");
+	REQUIRE(!loaded.load(garbage));
+}
+
+TEST_CASE("subscribing while delivering", "[event]") {
+	empty_manager<int> em;
+	std::vector<subscriber_handle<int>> added;
+	std::vector<int> calls;
+	subscriber_handle<int> self;
+	self = em.subscribe<int>([&](int x) {
+		calls.push_back(x);
+		// Every handler added here starts with the next event
+		for (int i = 0; i < 10; ++i) {
+			added.push_back(em.subscribe<int>([&calls, i](int x) { calls.push_back(x * 100 + i); }));
+		}
+		REQUIRE(self.unsubscribe());
+	});
+	auto other = em.subscribe<int>([&](int x) {
+		calls.push_back(-x);
+		// Removed handlers still hear about the event being delivered
+		for (auto &sub : added) sub.unsubscribe();
+		added.clear();
+		if (x == 1) em.broadcast(2);
+	});
+	em.broadcast(1);
+	REQUIRE((calls == std::vector<int>{1, -1, -2}));
+
+	calls.clear();
+	added.push_back(em.subscribe<int>([&](int x) { calls.push_back(x * 10); }));
+	em.set_queued<int>(true);
+	em.enqueue(3);
+	em.enqueue(4);
+	em.dispatch();
+	REQUIRE((calls == std::vector<int>{-3, -4, 30, 40}));
+
+	using target_manager = entity_manager<comps, tags>;
+	using entity_t = target_manager::entity_t;
+	target_manager entMan;
+	event_manager<comps, tags> evtMan;
+	entMan.set_event_manager(evtMan);
+	auto ent = entMan.create_entity();
+	int tagged = 0;
+	subscriber_handle<tag_added<entity_t, TA>> forEntity;
+	forEntity = evtMan.subscribe_for<tag_added<entity_t, TA>>(ent, [&](const auto &) {
+		++tagged;
+		forEntity.unsubscribe();
+	});
+	auto withTag = evtMan.subscribe_with_tag<tag_added<entity_t, TA>, TA>([&](const auto &) { ++tagged; });
+	ent.set_tag<TA>(true);
+	ent.set_tag<TA>(false);
+	ent.set_tag<TA>(true);
+	REQUIRE(tagged == 3);
+}
@@ -0,0 +1,93 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+#include <entityplus/event.h>
+
+using hierarchy_manager = entity_manager<comps, tags>;
+using hierarchy_entity = hierarchy_manager::entity_t;
+
+TEST_CASE("hierarchy", "[hierarchy]") {
+	hierarchy_manager em;
+#ifdef ENTITYPLUS_NO_EXCEPTIONS
+	em.set_error_callback(error_handler);
+#endif
+	auto root = em.create_entity(A{1});
+	auto child = em.create_entity(A{2});
+	auto grandchild = em.create_entity(A{3});
+	auto other = em.create_entity(A{10});
+	REQUIRE(em.get_parent(child).get_status() == entity_status::UNINITIALIZED);
+
+	em.set_parent(grandchild, child);
+	em.set_parent(child, root);
+	em.set_parent(other, root);
+	REQUIRE(em.get_parent(child) == root);
+	REQUIRE(em.get_parent(grandchild) == child);
+	REQUIRE((em.get_children(root) == hierarchy_manager::return_container{child, other}));
+	REQUIRE_THROWS(em.set_parent(root, grandchild));
+	REQUIRE_THROWS(em.set_parent(root, root));
+
+	// Reparenting within the same subtree keeps the order valid
+	em.set_parent(grandchild, root);
+	REQUIRE((em.get_children(root) == hierarchy_manager::return_container{child, other, grandchild}));
+	REQUIRE(em.get_children(child).empty());
+	em.set_parent(grandchild, child);
+
+	std::vector<int> sums;
+	em.for_each_topdown<A>([&](const hierarchy_entity &ent, A &a, A *parent) {
+		if (parent) a.x += parent->x;
+		REQUIRE((parent != nullptr) == (em.get_parent(ent).get_status() == entity_status::OK));
+		sums.push_back(a.x);
+	});
+	REQUIRE((sums == std::vector<int>{1, 3, 6, 11}));
+
+	// Children of a destroyed entity become roots
+	REQUIRE(!em.clear_parent(root));
+	child.destroy();
+	REQUIRE(em.get_parent(grandchild).get_status() == entity_status::UNINITIALIZED);
+	REQUIRE((em.get_children(root) == hierarchy_manager::return_container{other}));
+	em.set_parent(grandchild, other);
+	REQUIRE(em.clear_parent(other));
+	REQUIRE(em.get_children(root).empty());
+	REQUIRE(em.get_parent(grandchild) == other);
+}
+
+TEST_CASE("hierarchy cascading destroy", "[hierarchy]") {
+	hierarchy_manager em;
+	event_manager<comps, tags> events;
+	em.set_event_manager(events);
+	int destroyedCount = 0, removedA = 0;
+	events.subscribe<entity_destroyed<hierarchy_entity>>([&](const auto &) { ++destroyedCount; });
+	events.subscribe<component_removed<hierarchy_entity, A>>([&](const auto &) { ++removedA; });
+
+	std::vector<hierarchy_entity> ents;
+	for (int i = 0; i < 20; ++i) {
+		auto ent = em.create_entity(A{i});
+		if (i % 2 == 0) ent.add_component<B>("b");
+		if (i % 3 == 0) ent.set_tag<TA>(true);
+		if (i > 0) em.set_parent(ent, ents[(i - 1) / 2]);
+		ents.push_back(ent);
+	}
+	auto grouping = em.create_grouping<A, B>();
+
+	// ents[1] has 1, 3, 4, 7-10 and 15-19 under it
+	em.destroy_with_children(ents[1]);
+	REQUIRE(destroyedCount == 12);
+	REQUIRE(removedA == 12);
+	std::vector<int> left;
+	for (auto ent : em.get_entities<A>()) left.push_back(ent.get_component<A>().x);
+	REQUIRE((left == std::vector<int>{0, 2, 5, 6, 11, 12, 13, 14}));
+	REQUIRE(em.get_entities<A, B>().size() == 5);
+	REQUIRE(em.get_entities<TA>().size() == 3);
+	REQUIRE(em.get_entities<A, TA>().size() == 3);
+	REQUIRE((em.get_children(ents[0]) == hierarchy_manager::return_container{ents[2]}));
+
+	int visited = 0;
+	em.for_each_topdown<A, B>([&](auto, A &, B &, A *parentA, B *parentB) {
+		REQUIRE((parentA == nullptr) == (parentB == nullptr));
+		++visited;
+	});
+	REQUIRE(visited == 5);
+}
@@ -72,6 +72,19 @@ static_assert(std::is_same<
 	typelist<>
 >{}, "");
 
+static_assert(std::is_same<
+	typelist_difference_t<typelist<int, float, double>, typelist <double, char>>,
+	typelist<int, float>
+>{}, "");
+static_assert(std::is_same<
+	typelist_difference_t<typelist<int, float, double>, typelist <>>,
+	typelist<int, float, double>
+>{}, "");
+static_assert(std::is_same<
+	typelist_difference_t<typelist<>, typelist <int, float, double>>,
+	typelist<>
+>{}, "");
+
 TEST_CASE("for_each", "[metafunctions]") {
 	const std::tuple<int, float, double> tupOriginal{2, 3.4f, 5.6};
 	SECTION("triple with ref") {
@@ -0,0 +1,200 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+#include <entityplus/event.h>
+
+struct prefab_sorted {
+	int x;
+};
+struct prefab_sparse {
+	int x;
+};
+struct prefab_paged {
+	int x;
+};
+struct prefab_hash {
+	int x;
+};
+struct prefab_soa {
+	float x, y;
+};
+
+namespace entityplus {
+template <>
+struct component_storage_traits<prefab_sorted> : sorted_storage {};
+template <>
+struct component_storage_traits<prefab_sparse> : sparse_storage {};
+template <>
+struct component_storage_traits<prefab_paged> : paged_storage<4> {};
+template <>
+struct component_storage_traits<prefab_hash> : hash_storage {};
+template <>
+struct soa_traits<prefab_soa>
+	: soa_layout<prefab_soa, ENTITYPLUS_SOA_FIELD(prefab_soa, x), ENTITYPLUS_SOA_FIELD(prefab_soa, y)> {};
+}
+
+using prefab_manager = entity_manager<comps, tags>;
+using prefab_entity = prefab_manager::entity_t;
+
+TEST_CASE("prefabs", "[prefab]") {
+	prefab_manager em;
+	auto before = em.create_entity(A{1});
+	auto grouping = em.create_grouping<A, TB>();
+
+	event_manager<comps, tags> events;
+	em.set_event_manager(events);
+	int created = 0, addedA = 0, addedTB = 0;
+	events.subscribe<entity_created<prefab_entity>>([&](const auto &) { ++created; });
+	events.subscribe<component_added<prefab_entity, A>>([&](const auto &event) {
+		REQUIRE(event.component.x == 5);
+		++addedA;
+	});
+	events.subscribe<tag_added<prefab_entity, TB>>([&](const auto &) { ++addedTB; });
+
+	auto prefab = em.create_prefab<TB>(A{5}, B{"orc"});
+	REQUIRE(prefab.has_component<A>());
+	REQUIRE(!prefab.has_component<C>());
+	REQUIRE(prefab.has_tag<TB>());
+	REQUIRE(prefab.get_component<B>().name == "orc");
+
+	auto ents = em.instantiate(prefab, 10);
+	REQUIRE(ents.size() == 10);
+	REQUIRE(created == 10);
+	REQUIRE(addedA == 10);
+	REQUIRE(addedTB == 10);
+	for (auto &ent : ents) {
+		REQUIRE(ent.get_status() == entity_status::OK);
+		REQUIRE(before < ent);
+		REQUIRE(ent.get_component<A>().x == 5);
+		REQUIRE(ent.get_component<B>().name == "orc");
+		REQUIRE(!ent.has_component<C>());
+		REQUIRE(ent.has_tag<TB>());
+	}
+	REQUIRE(std::is_sorted(ents.begin(), ents.end()));
+	REQUIRE(em.get_entities<A, TB>() == ents);
+	REQUIRE(em.get_entities<B>() == ents);
+	REQUIRE(em.get_entities<A>().size() == 11);
+
+	// Copies don't share state
+	ents[0].get_component<A>().x = 7;
+	REQUIRE(ents[1].get_component<A>().x == 5);
+	REQUIRE(prefab.get_component<A>().x == 5);
+	REQUIRE(em.instantiate(prefab, 0).empty());
+
+	// Entities created afterwards still go at the end
+	auto after = em.create_entity<TB>(A{5});
+	REQUIRE(ents.back() < after);
+	REQUIRE(em.get_entities<A, TB>().back() == after);
+}
+
+TEST_CASE("cloning", "[prefab]") {
+	prefab_manager em;
+	auto parent = em.create_entity(A{1});
+	auto ent = em.create_entity<TA, TC>(A{2}, C{3, 4});
+	em.set_parent(ent, parent);
+
+	auto copy = em.clone(ent);
+	REQUIRE(!(copy == ent));
+	REQUIRE(copy.get_component<A>().x == 2);
+	REQUIRE(copy.get_component<C>().get() == 4);
+	REQUIRE(!copy.has_component<B>());
+	REQUIRE(copy.has_tag<TA>());
+	REQUIRE(!copy.has_tag<TB>());
+	REQUIRE(copy.has_tag<TC>());
+	REQUIRE(em.get_parent(copy).get_status() == entity_status::UNINITIALIZED);
+	REQUIRE(em.get_entities<A, C, TA>().size() == 2);
+
+	auto prefab = em.make_prefab(ent);
+	ent.get_component<A>().x = 9;
+	REQUIRE(prefab.get_component<A>().x == 2);
+	REQUIRE(em.instantiate(prefab, 3).back().get_component<A>().x == 2);
+	REQUIRE(em.get_entities<TC>().size() == 5);
+}
+
+TEST_CASE("instantiating into every storage", "[prefab]") {
+	entity_manager<component_list<prefab_sorted, prefab_sparse, prefab_paged, prefab_hash, prefab_soa>, tags> em;
+	auto prefab = em.create_prefab(prefab_sorted{1}, prefab_sparse{2}, prefab_paged{3},
+								   prefab_hash{4}, prefab_soa{5, 6});
+	em.create_entity(prefab_paged{0});
+	for (int round = 0; round < 3; ++round) em.instantiate(prefab, 5);
+
+	int count = 0;
+	em.for_each<prefab_sorted, prefab_sparse, prefab_paged, prefab_hash, prefab_soa>(
+		[&](auto ent, prefab_sorted &sorted, prefab_sparse &sparse, prefab_paged &paged, prefab_hash &hash, auto soa) {
+		REQUIRE(sorted.x + sparse.x + paged.x + hash.x == 10);
+		REQUIRE(soa[&prefab_soa::y] == 6);
+		REQUIRE(ent.template get_component<prefab_paged>().x == 3);
+		++count;
+	});
+	REQUIRE(count == 15);
+	REQUIRE(em.get_entities<prefab_paged>().size() == 16);
+}
+
+TEST_CASE("batched events from bulk operations", "[prefab]") {
+	using batch_comps = component_list<prefab_sorted, prefab_soa>;
+	using batch_manager = entity_manager<batch_comps, tags>;
+	using entity_t = batch_manager::entity_t;
+	batch_manager em;
+	event_manager<batch_comps, tags> events;
+	em.set_event_manager(events);
+
+	std::vector<std::size_t> created, sorted, soa, tagged;
+	float soaSum = 0;
+	int single = 0;
+	events.subscribe_batch<entity_created<entity_t>>([&](event_span<entity_created<entity_t>> batch) {
+		created.push_back(batch.size());
+	});
+	events.subscribe_batch<component_added<entity_t, prefab_sorted>>(
+		[&](event_span<component_added<entity_t, prefab_sorted>> batch) {
+		sorted.push_back(batch.size());
+		for (const auto &event : batch) event.component.x += 1;
+	});
+	events.subscribe_batch<component_added<entity_t, prefab_soa>>(
+		[&](event_span<component_added<entity_t, prefab_soa>> batch) {
+		soa.push_back(batch.size());
+		for (const auto &event : batch) soaSum += event.component.x + event.component.y;
+	});
+	events.subscribe_batch<tag_added<entity_t, TA>>([&](event_span<tag_added<entity_t, TA>> batch) {
+		tagged.push_back(batch.size());
+	});
+	// Plain subscribers still get one call per event
+	events.subscribe<component_added<entity_t, prefab_sorted>>([&](const auto &) { ++single; });
+
+	auto prefab = em.create_prefab<TA>(prefab_sorted{1}, prefab_soa{2, 3});
+	auto ents = em.instantiate(prefab, 50);
+	auto copy = em.clone(ents[0]);
+	REQUIRE((created == std::vector<std::size_t>{50, 1}));
+	REQUIRE((sorted == std::vector<std::size_t>{50, 1}));
+	REQUIRE((soa == std::vector<std::size_t>{50, 1}));
+	REQUIRE((tagged == std::vector<std::size_t>{50, 1}));
+	REQUIRE(single == 51);
+	REQUIRE(soaSum == 51 * 5);
+	// The components are the stored ones
+	REQUIRE(ents[3].get_component<prefab_sorted>().x == 2);
+	REQUIRE(copy.get_component<prefab_sorted>().x == 3);
+
+	std::vector<std::size_t> destroyed, removed;
+	std::vector<entity_t> destroyedOrder;
+	events.subscribe_batch<entity_destroyed<entity_t>>([&](event_span<entity_destroyed<entity_t>> batch) {
+		destroyed.push_back(batch.size());
+		for (const auto &event : batch) destroyedOrder.push_back(event.entity);
+	});
+	events.subscribe_batch<component_removed<entity_t, prefab_soa>>(
+		[&](event_span<component_removed<entity_t, prefab_soa>> batch) {
+		removed.push_back(batch.size());
+		for (const auto &event : batch) REQUIRE(event.component.y == 3);
+	});
+	em.set_parent(ents[1], ents[5]);
+	em.set_parent(ents[2], ents[5]);
+	em.destroy_with_children(ents[5]);
+	REQUIRE((destroyed == std::vector<std::size_t>{3}));
+	REQUIRE(destroyedOrder.front() == ents[5]);
+	REQUIRE((removed == std::vector<std::size_t>{3}));
+
+	em.clear();
+	REQUIRE((destroyed == std::vector<std::size_t>{3, 48}));
+	REQUIRE((removed == std::vector<std::size_t>{3, 48}));
+}
@@ -0,0 +1,89 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+
+#include <string>
+
+struct material {
+	std::string name;
+	int layers;
+	material(std::string name, int layers) : name(std::move(name)), layers(layers) {}
+	bool operator==(const material &other) const {
+		return name == other.name && layers == other.layers;
+	}
+};
+
+struct material_hash {
+	std::size_t operator()(const material &mat) const {
+		return std::hash<std::string>{}(mat.name) ^ std::size_t(mat.layers);
+	}
+};
+
+using shared_material = shared<material, material_hash>;
+using shared_manager = entity_manager<component_list<shared_material, A>, tags>;
+
+TEST_CASE("shared values", "[shared]") {
+	detail::shared_pool<std::string, std::hash<std::string>, std::equal_to<std::string>> pool;
+	{
+		shared<std::string> a(pool, "stone"), b(pool, "stone"), c(pool, "grass");
+		REQUIRE(&*a == &*b);
+		REQUIRE(a.use_count() == 2);
+		REQUIRE(c.use_count() == 1);
+		REQUIRE(pool.size() == 2);
+
+		auto d = a;
+		REQUIRE(a.use_count() == 3);
+
+		d.modify() = "sand";
+		REQUIRE(*a == "stone");
+		REQUIRE(*d == "sand");
+		REQUIRE(a.use_count() == 2);
+		REQUIRE(pool.size() == 3);
+
+		// Modified values are no longer found by value
+		shared<std::string> e(pool, "sand");
+		REQUIRE(&*e != &*d);
+
+		b = c;
+		REQUIRE(a.use_count() == 1);
+		REQUIRE(c.use_count() == 2);
+	}
+	REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("shared components", "[shared]") {
+	shared_manager em;
+	auto ent1 = em.create_entity(A{0});
+	auto ent2 = em.create_entity();
+	auto ent3 = em.create_entity();
+
+	ent1.add_component<shared_material>("brick", 2);
+	ent2.add_component<shared_material>(material{"brick", 2});
+	ent3.add_component<shared_material>("glass", 1);
+	REQUIRE(em.shared_value_count<shared_material>() == 2);
+	REQUIRE(&*ent1.get_component<shared_material>() == &*ent2.get_component<shared_material>());
+
+	int count = 0;
+	em.for_each<shared_material>([&](auto ent, const material &mat) {
+		(void)ent;
+		REQUIRE(mat.layers == (mat.name == "brick" ? 2 : 1));
+		++count;
+	});
+	REQUIRE(count == 3);
+
+	em.for_each<shared_material, A>([&](auto ent, const material &mat, A &) {
+		REQUIRE(ent == ent1);
+		REQUIRE(mat.name == "brick");
+	});
+
+	ent2.get_component<shared_material>().modify().layers = 3;
+	REQUIRE(ent1.get_component<shared_material>()->layers == 2);
+	REQUIRE(em.shared_value_count<shared_material>() == 3);
+
+	ent3.remove_component<shared_material>();
+	ent2.destroy();
+	REQUIRE(em.shared_value_count<shared_material>() == 1);
+}
@@ -0,0 +1,108 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+#include <entityplus/event.h>
+
+struct vec3 {
+	float x, y, z;
+};
+
+namespace entityplus {
+template <>
+struct soa_traits<vec3>
+	: soa_layout<vec3, ENTITYPLUS_SOA_FIELD(vec3, x), ENTITYPLUS_SOA_FIELD(vec3, y), ENTITYPLUS_SOA_FIELD(vec3, z)> {};
+}
+
+using soa_manager = entity_manager<component_list<vec3, A>, tags>;
+using soa_entity = soa_manager::entity_t;
+
+TEST_CASE("soa components", "[soa]") {
+	soa_manager em;
+	std::vector<soa_entity> ents;
+	for (int i = 0; i < 10; ++i) {
+		auto ent = em.create_entity(vec3{float(i), float(2 * i), float(3 * i)});
+		if (i % 2 == 0) ent.add_component<A>(i);
+		ents.push_back(ent);
+	}
+
+	vec3 val = ents[3].get_component<vec3>();
+	REQUIRE(val.y == 6);
+	ents[3].get_component<vec3>()[&vec3::y] = 7;
+	REQUIRE(meta::as_const(ents[3]).get_component<vec3>().y == 7);
+	ents[3].get_component<vec3>() = vec3{3, 6, 9};
+
+	auto added = ents[1].add_component<vec3>(vec3{0, 0, 0});
+	REQUIRE(!added.second);
+	REQUIRE(added.first[&vec3::z] == 3);
+
+	int count = 0;
+	em.for_each<vec3, A>([&](auto ent, auto pos, A &a) {
+		REQUIRE(pos[&vec3::x] == a.x);
+		pos[&vec3::x] += 1;
+		(void)ent;
+		++count;
+	});
+	REQUIRE(count == 5);
+	REQUIRE(ents[4].get_component<vec3>()[&vec3::x] == 5);
+	REQUIRE(ents[5].get_component<vec3>()[&vec3::x] == 5);
+
+	ents[0].destroy();
+	REQUIRE(ents[2].remove_component<vec3>());
+	count = 0;
+	for (auto &&row : em.query<vec3>()) {
+		auto ent = std::get<0>(row);
+		vec3 pos = std::get<1>(row);
+		REQUIRE(pos.y == 2 * (ent == ents[4] || ent == ents[6] || ent == ents[8] ? pos.x - 1 : pos.x));
+		++count;
+	}
+	REQUIRE(count == 8);
+}
+
+TEST_CASE("soa chunks", "[soa]") {
+	soa_manager em;
+	for (int i = 0; i < 100; ++i) {
+		em.create_entity(vec3{float(i), 1, 0});
+	}
+
+	std::size_t values = 0;
+	float sum = 0;
+	em.for_each_chunk<vec3>(32, [&](auto chunk) {
+		REQUIRE(chunk.size() <= 32);
+		auto xs = chunk[&vec3::x];
+		auto ys = chunk[&vec3::y];
+		REQUIRE(reinterpret_cast<std::uintptr_t>(chunk[&vec3::z].data()) % 64 == 0);
+		for (std::size_t i = 0; i < chunk.size(); ++i) {
+			sum += xs[i] * ys[i];
+			ys[i] = 2;
+		}
+		values += chunk.size();
+	});
+	REQUIRE(values == 100);
+	REQUIRE(sum == 4950);
+
+	em.for_each<vec3>([](auto, vec3 pos) {
+		REQUIRE(pos.y == 2);
+	});
+
+	em.sort<vec3>([](const vec3 &lhs, const vec3 &rhs) { return lhs.x > rhs.x; });
+	float last = 100;
+	em.for_each<vec3>([&](auto, auto pos) {
+		REQUIRE(pos[&vec3::x] < last);
+		last = pos[&vec3::x];
+	});
+}
+
+TEST_CASE("soa component events", "[soa]") {
+	soa_manager em;
+	event_manager<component_list<vec3, A>, tags> events;
+	em.set_event_manager(events);
+	float removedZ = 0;
+	events.subscribe<component_removed<soa_entity, vec3>>([&](const auto &event) { removedZ = event.component.z; });
+
+	auto ent = em.create_entity(vec3{1, 2, 3});
+	ent.remove_component<vec3>();
+	REQUIRE(removedZ == 3);
+}
@@ -0,0 +1,98 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+
+struct position {
+	float x, y;
+	position(float x, float y): x(x), y(y) {}
+};
+
+using spatial_manager = entity_manager<component_list<position, A>, tags>;
+
+static spatial_point to_point(const position &pos) {
+	return {pos.x, pos.y, 0};
+}
+
+TEST_CASE("spatial grid", "[spatial]") {
+	detail::spatial_grid grid{2.f};
+	grid.insert(0, {0, 0, 0});
+	grid.insert(1, {3, 0, 0});
+	grid.insert(2, {10, 10, 0});
+	REQUIRE(grid.size() == 3);
+
+	std::vector<detail::entity_id_t> found;
+	grid.for_each_within({0, 0, 0}, 4.f, [&](detail::entity_id_t id, float) { found.push_back(id); });
+	std::sort(found.begin(), found.end());
+	REQUIRE((found == std::vector<detail::entity_id_t>{0, 1}));
+
+	grid.update(1, {9, 9, 0});
+	found.clear();
+	grid.for_each_within({0, 0, 0}, 4.f, [&](detail::entity_id_t id, float) { found.push_back(id); });
+	REQUIRE((found == std::vector<detail::entity_id_t>{0}));
+
+	std::vector<std::pair<float, detail::entity_id_t>> nearest;
+	grid.nearest({10, 10, 0}, 2, nearest);
+	REQUIRE(nearest.size() == 2);
+	REQUIRE(nearest[0].second == 2);
+	REQUIRE(nearest[1].second == 1);
+
+	REQUIRE(grid.erase(2));
+	REQUIRE(!grid.erase(2));
+	grid.nearest({10, 10, 0}, 5, nearest);
+	REQUIRE(nearest.size() == 2);
+	REQUIRE(nearest[0].second == 1);
+}
+
+TEST_CASE("for_each_within", "[spatial]") {
+	spatial_manager em;
+	auto origin = em.create_entity(position{0, 0});
+	auto near = em.create_entity<TA>(position{1, 1}, A{1});
+	auto far = em.create_entity<TA>(position{50, 50}, A{2});
+	em.create_spatial_index<position>(4.f, to_point);
+	auto late = em.create_entity(position{-1, 0}, A{3});
+
+	std::vector<spatial_manager::entity_t> found;
+	em.for_each_within<position>({0, 0, 0}, 2.f, [&](auto ent, auto &) {
+		found.push_back(ent);
+	});
+	REQUIRE(found.size() == 3);
+	REQUIRE(std::find(found.begin(), found.end(), far) == found.end());
+
+	int sum = 0;
+	em.for_each_within<position, A, TA>({0, 0, 0}, 2.f, [&](auto, auto &, auto &a) {
+		sum += a.x;
+	});
+	REQUIRE(sum == 1);
+
+	far.get_component<position>() = position{0, 1};
+	em.update_spatial_index<position>(far);
+	sum = 0;
+	em.for_each_within<position, A>({0, 0, 0}, 2.f, [&](auto, auto &, auto &a) {
+		sum += a.x;
+	});
+	REQUIRE(sum == 6);
+
+	late.destroy();
+	near.remove_component<position>();
+	found.clear();
+	em.for_each_within<position>({0, 0, 0}, 2.f, [&](auto ent, auto &) {
+		found.push_back(ent);
+	});
+	REQUIRE(found.size() == 2);
+
+	em.create_grouping<position, TA>();
+	int count = 0;
+	em.for_each_within<position, TA>({0, 0, 0}, 100.f, [&](auto, auto &) {
+		++count;
+	});
+	REQUIRE(count == 1);
+
+	auto nearest = em.get_nearest<position>({{0, 0, 0}, {0, 2, 0}}, 1);
+	REQUIRE(nearest.size() == 2);
+	REQUIRE(nearest[0].size() == 1);
+	REQUIRE(nearest[0][0] == origin);
+	REQUIRE(nearest[1][0] == far);
+}
@@ -0,0 +1,181 @@
+//          Copyright Elnar Dakeshov 2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include "test_common.h"
+#include <entityplus/event.h>
+
+struct sorted_comp {
+	int x;
+};
+struct sparse_comp {
+	int x;
+};
+struct paged_comp {
+	int x;
+};
+struct hash_comp {
+	int x;
+};
+
+namespace entityplus {
+template <>
+struct component_storage_traits<sorted_comp> : sorted_storage {};
+template <>
+struct component_storage_traits<sparse_comp> : sparse_storage {};
+template <>
+struct component_storage_traits<paged_comp> : paged_storage<8> {};
+template <>
+struct component_storage_traits<hash_comp> : hash_storage {};
+}
+
+using storage_manager = entity_manager<component_list<A, sorted_comp, sparse_comp, paged_comp, hash_comp>, tags>;
+using storage_entity = storage_manager::entity_t;
+
+TEST_CASE("mixed storage", "[storage]") {
+	storage_manager em;
+	std::vector<storage_entity> ents;
+	for (int i = 0; i < 40; ++i) {
+		auto ent = em.create_entity(A{i}, sorted_comp{i}, paged_comp{i});
+		if (i % 2 == 0) ent.add_component<hash_comp>(hash_comp{i});
+		if (i % 5 == 0) ent.add_component<sparse_comp>(sparse_comp{i});
+		ents.push_back(ent);
+	}
+	REQUIRE(ents[10].get_component<sparse_comp>().x == 10);
+	ents[10].get_component<hash_comp>().x = 11;
+	REQUIRE(meta::as_const(ents[10]).get_component<hash_comp>().x == 11);
+	ents[10].get_component<hash_comp>().x = 10;
+
+	int count = 0;
+	em.for_each<A, sorted_comp, sparse_comp, paged_comp, hash_comp>([&](auto, A &a, sorted_comp &sorted, sparse_comp &sparse,
+																		paged_comp &paged, hash_comp &hash) {
+		REQUIRE(a.x % 10 == 0);
+		REQUIRE((sorted.x == a.x && sparse.x == a.x && paged.x == a.x && hash.x == a.x));
+		++count;
+	});
+	REQUIRE(count == 4);
+
+	ents[20].remove_component<sparse_comp>();
+	ents[30].destroy();
+	auto grouping = em.create_grouping<sparse_comp, hash_comp>();
+	count = 0;
+	em.for_each<sparse_comp, hash_comp>([&](auto, sparse_comp &sparse, hash_comp &hash) {
+		REQUIRE(sparse.x == hash.x);
+		++count;
+	});
+	REQUIRE(count == 2);
+
+	count = 0;
+	for (auto &&row : em.query<paged_comp, hash_comp>()) {
+		REQUIRE(std::get<1>(row).x == std::get<2>(row).x);
+		++count;
+	}
+	REQUIRE(count == 19);
+}
+
+TEST_CASE("mixed storage sort", "[storage]") {
+	storage_manager em;
+	for (int i = 0; i < 10; ++i) {
+		em.create_entity(A{i}, hash_comp{i}, sorted_comp{i});
+	}
+	// Unsortable storage still follows the leader's order
+	em.sort<A>([](const A &lhs, const A &rhs) { return lhs.x > rhs.x; });
+	int last = 10;
+	em.for_each<A, hash_comp, sorted_comp>([&](auto, A &a, hash_comp &hash, sorted_comp &sorted) {
+		REQUIRE(a.x < last);
+		REQUIRE((hash.x == a.x && sorted.x == a.x));
+		last = a.x;
+	});
+	REQUIRE(last == 0);
+}
+
+TEST_CASE("memory stats", "[storage]") {
+	storage_manager em;
+	em.reserve<A, sparse_comp>(100, 100, 50);
+	auto reserved = em.memory_stats();
+	REQUIRE(reserved.entities.size == 0);
+	REQUIRE(reserved.entities.capacity >= 100);
+	REQUIRE(reserved.tags.capacity >= 3 * 100);
+	REQUIRE(reserved.components[0].capacity >= 100);
+	REQUIRE(reserved.components[2].capacity >= 50);
+	REQUIRE(reserved.groupings.size() == 5);
+	REQUIRE(reserved.groupings[0].capacity >= 100);
+	REQUIRE(reserved.total_slack() == reserved.total_bytes());
+
+	std::vector<storage_entity> ents;
+	for (int i = 0; i < 100; ++i) {
+		ents.push_back(em.create_entity<TA>(A{i}, sparse_comp{i}, paged_comp{i}, hash_comp{i}));
+	}
+	auto grouping = em.create_grouping<A, TA>();
+	auto full = em.memory_stats();
+	REQUIRE(full.entities.size == 100);
+	REQUIRE(full.tags.size == 3 * 100);
+	REQUIRE(full.components[3].size == 100);
+	REQUIRE(full.components[4].size == 100);
+	REQUIRE(full.groupings.size() == 6);
+	REQUIRE(full.groupings.back().size == 100);
+
+	for (int i = 10; i < 100; ++i) ents[i].destroy();
+	auto emptied = em.memory_stats();
+	REQUIRE(emptied.entities.capacity == full.entities.capacity);
+	em.shrink_to_fit();
+	auto shrunk = em.memory_stats();
+	REQUIRE(shrunk.entities.size == 10);
+	REQUIRE(shrunk.total_bytes() < emptied.total_bytes());
+	REQUIRE(shrunk.total_slack() < emptied.total_slack());
+	for (std::size_t i = 0; i < shrunk.components.size(); ++i) {
+		REQUIRE(shrunk.components[i].size == (i == 1 ? 0 : 10));
+	}
+	REQUIRE(ents[9].get_component<sparse_comp>().x == 9);
+	REQUIRE(em.get_entities<A, TA>().size() == 10);
+}
+
+TEST_CASE("clear", "[storage]") {
+	storage_manager em;
+	event_manager<component_list<A, sorted_comp, sparse_comp, paged_comp, hash_comp>, tags> events;
+	em.set_event_manager(events);
+	int destroyed = 0, removedSparse = 0, removedTA = 0;
+	events.subscribe<entity_destroyed<storage_entity>>([&](const auto &) { ++destroyed; });
+	events.subscribe<component_removed<storage_entity, sparse_comp>>([&](const auto &event) {
+		REQUIRE(event.component.x % 3 == 0);
+		REQUIRE(event.entity.template get_component<A>().x == event.component.x);
+		++removedSparse;
+	});
+	events.subscribe<tag_removed<storage_entity, TA>>([&](const auto &) { ++removedTA; });
+
+	std::vector<storage_entity> ents;
+	for (int i = 0; i < 30; ++i) {
+		auto ent = em.create_entity(A{i}, sorted_comp{i}, paged_comp{i}, hash_comp{i});
+		if (i % 3 == 0) ent.add_component<sparse_comp>(sparse_comp{i});
+		if (i % 2 == 0) ent.set_tag<TA>(true);
+		if (i > 0) em.set_parent(ent, ents[0]);
+		ents.push_back(ent);
+	}
+	auto grouping = em.create_grouping<A, TA>();
+	auto before = em.memory_stats();
+
+	em.clear();
+	REQUIRE(destroyed == 30);
+	REQUIRE(removedSparse == 10);
+	REQUIRE(removedTA == 15);
+	REQUIRE(ents[3].get_status() == entity_status::DELETED);
+	REQUIRE(em.get_entities<>().empty());
+	REQUIRE(em.get_entities<A, TA>().empty());
+	em.for_each<A>([](auto, A &) { REQUIRE(false); });
+	em.for_each_topdown<A>([](auto, A &, A *) { REQUIRE(false); });
+	auto after = em.memory_stats();
+	REQUIRE(after.total_bytes() - after.total_slack() < before.total_bytes() - before.total_slack());
+	REQUIRE(after.entities.capacity == before.entities.capacity);
+	REQUIRE(after.components[0].capacity == before.components[0].capacity);
+
+	// Everything works as before once refilled
+	auto ent = em.create_entity<TA>(A{1}, sparse_comp{3});
+	REQUIRE(ents.back() < ent);
+	REQUIRE((em.get_entities<A, TA>() == storage_manager::return_container{ent}));
+	REQUIRE(em.get_entities<sparse_comp>().size() == 1);
+
+	em.clear(false, true);
+	REQUIRE(destroyed == 30);
+	REQUIRE(em.create_entity(A{0}) == ents[0]);
+}
@@ -7,6 +7,7 @@
 
 #include "metafunctions.h"
 #include "container.h"
+#include "soa.h"
 
 #include <cstdint>
 
@@ -20,12 +21,17 @@ struct tag_list {
 	static_assert(meta::is_typelist_unique_v<meta::typelist<Ts...>>, "tag_list must be unique");
 };
 
+template <typename... Ts>
+struct singleton_list {
+	static_assert(meta::is_typelist_unique_v<meta::typelist<Ts...>>, "singleton_list must be unique");
+};
+
 template <typename... Ts>
 struct component_list {
 	static_assert(meta::is_typelist_unique_v<meta::typelist<Ts...>>, "component_list must be unique");
 
 	template <typename T>
-	using container_type = flat_map<detail::entity_id_t, T>;
+	using container_type = typename detail::component_storage<T>::template container_type<detail::entity_id_t>;
 	using type = std::tuple<container_type<Ts>...>;
 };
 }